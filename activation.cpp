@@ -0,0 +1,49 @@
+#include "activation.h"
+
+#include <cassert>
+#include <stdexcept>
+
+#include "kernels.h"
+
+static void check(activation activation) {
+    if (activation > activation::softmax)
+        throw std::out_of_range("invalid activation");
+}
+
+void activate(activation activation, Eigen::Ref<Eigen::MatrixXf> a) {
+    check(activation);
+    kernels::get().activate(activation, a.data(), a.rows(), a.cols(), a.outerStride());
+}
+
+void multiply_derivative(activation activation, Eigen::Ref<Eigen::MatrixXf const> const &a, Eigen::Ref<Eigen::MatrixXf> delta) {
+    check(activation);
+    assert(a.rows() == delta.rows() && a.cols() == delta.cols());
+    kernels::get().multiply_derivative(activation, a.data(), a.outerStride(), delta.data(), delta.outerStride(),
+                                       a.rows(), a.cols());
+}
+
+loss output_loss(activation output) {
+    return output == activation::softmax ? loss::cross_entropy : loss::squared_error;
+}
+
+std::string activation_name(activation activation) {
+    switch (activation) {
+        case activation::sigmoid: return "sigmoid";
+        case activation::tanh: return "tanh";
+        case activation::relu: return "relu";
+        case activation::softmax: return "softmax";
+    }
+    throw std::out_of_range("invalid activation");
+}
+
+activation parse_activation(std::string const &name) {
+    if (name == "sigmoid")
+        return activation::sigmoid;
+    if (name == "tanh")
+        return activation::tanh;
+    if (name == "relu")
+        return activation::relu;
+    if (name == "softmax")
+        return activation::softmax;
+    throw std::invalid_argument("invalid activation " + name);
+}
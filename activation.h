@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <Eigen/Eigen>
+
+enum class activation : uint32_t {
+    sigmoid = 0,
+    tanh = 1,
+    relu = 2,
+    // output layer only, normalizes every column to probabilities
+    softmax = 3,
+};
+
+// training loss of the output layer
+enum class loss {
+    squared_error,
+    // of softmax outputs
+    cross_entropy,
+};
+
+// Vectorized activation kernels. f works on pre-activations, derivative
+// takes the activations f already produced so nothing is recomputed.
+struct sigmoid_activation {
+    template <typename Z>
+    static auto f(Z const &z) { return (1.0f + (-z).exp()).inverse(); }
+    template <typename A>
+    static auto derivative(A const &a) { return a * (1.0f - a); }
+};
+
+struct tanh_activation {
+    template <typename Z>
+    static auto f(Z const &z) { return z.tanh(); }
+    template <typename A>
+    static auto derivative(A const &a) { return 1.0f - a.square(); }
+};
+
+struct relu_activation {
+    template <typename Z>
+    static auto f(Z const &z) { return z.max(0.0f); }
+    template <typename A>
+    static auto derivative(A const &a) { return (a > 0.0f).template cast<float>(); }
+};
+
+// a = f(a), in place over the pre-activations
+void activate(activation activation, Eigen::Ref<Eigen::MatrixXf> a);
+// delta *= f'(a), a no-op for softmax: with cross-entropy the output error
+// onehot - a already is the gradient of the pre-activations
+void multiply_derivative(activation activation, Eigen::Ref<Eigen::MatrixXf const> const &a, Eigen::Ref<Eigen::MatrixXf> delta);
+
+loss output_loss(activation output);
+
+std::string activation_name(activation activation);
+activation parse_activation(std::string const &name);
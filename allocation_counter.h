@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts heap allocations of the whole process (malloc and friends, which
+// operator new and Eigen end up in). Linking it replaces glibc's malloc, so
+// only the bench does, to check the warm loops stay off the heap.
+namespace allocation_counter {
+    size_t count();
+}
@@ -4,23 +4,57 @@
 #include <GL/glext.h>
 #include <GL/glut.h>
 #include <GL/freeglut.h>
+#include <filesystem>
+#include <sstream>
+#include <unistd.h>
 
 Application *Application::instance_ = nullptr;
 
-Application::Application(int argc, char *argv[], mode mode, std::string const &coefficients_path)
+static char const *const TRAINING_IMAGES = "images/train-images.idx3-ubyte";
+static char const *const TRAINING_LABELS = "images/train-labels.idx1-ubyte";
+
+static std::vector<size_t> topology(std::vector<size_t> const &hidden) {
+    std::vector<size_t> sizes{digit_image::IMAGE_SIZE};
+    sizes.insert(sizes.end(), hidden.begin(), hidden.end());
+    sizes.push_back(10);
+    return sizes;
+}
+
+// Files read without the dense network take any topology, debug mode feeds
+// them an image and reads a score per digit.
+static void check_digit_topology(size_t inputs, size_t outputs) {
+    if (inputs != digit_image::IMAGE_SIZE || outputs != 10) {
+        throw std::runtime_error("coefficients topology does not match the network: " + std::to_string(inputs)
+                                 + " inputs and " + std::to_string(outputs) + " outputs");
+    }
+}
+
+Application::Application(int argc, char *argv[], mode mode, std::string const &coefficients_path, options const &options)
     : argc_(argc)
     , argv_(argv)
     , mode_(mode)
-    , nn_(0.1f, 4, digit_image::IMAGE_SIZE, 196, 49, 10)
+    , options_(options)
+    , nn_(0.1f, topology(options.hidden))
     , coefficients_path_(coefficients_path)
-    , random_engine_(std::chrono::system_clock::now().time_since_epoch().count())
+    , random_engine_(options.seed)
+    , pool_(options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency()))
+    , predicted_points_(0)
+    , predicted_version_(0)
     , training_on_digit_(-1)
 {
     if (instance_ != nullptr) {
         throw std::logic_error("Application has already been instantiated");
     }
     instance_ = this;
-    read_coefficients();
+    // coefficient files carry their own activations
+    for (size_t layer = 1; layer + 1 < nn_.layer_sizes().size(); layer++)
+        nn_.set_activation(layer, options_.hidden_activation);
+    nn_.set_activation(nn_.layer_sizes().size() - 1, options_.output_activation);
+    if (options_.hidden_activation != activation::sigmoid || options_.output_activation != activation::sigmoid)
+        nn_.randomize();
+    // debugging maps binary coefficients on its own
+    if (mode_ != mode::debugging && mode_ != mode::ensembling && mode_ != mode::sweeping)
+        read_coefficients();
 }
 
 void Application::run() {
@@ -34,68 +68,39 @@ void Application::run() {
         case mode::interactive:
             run_interactive();
             break;
+        case mode::converting:
+            run_converting();
+            break;
+        case mode::quantizing:
+            run_quantizing();
+            break;
+        case mode::serving:
+            run_serving();
+            break;
+        case mode::ensembling:
+            run_ensemble();
+            break;
+        case mode::sweeping:
+            run_sweep();
+            break;
+        case mode::pruning:
+            run_pruning();
+            break;
+        case mode::exporting:
+            run_exporting();
+            break;
         default:
             throw std::out_of_range("invalid mode_");
             break;
     }
 }
 
-std::vector<digit_image> Application::get_all_images() {
-    mnist_file train_file("images/train-images.idx3-ubyte", "images/train-labels.idx1-ubyte");
-    /* mnist_file test_file("images/t10k-images.idx3-ubyte", "images/t10k-labels.idx1-ubyte"); */
-
-    std::vector<digit_image> images;
-    while (train_file.has_next_image())
-        images.emplace_back(train_file.next_image());
-    /* while (test_file.has_next_image()) */
-    /*     images.emplace_back(test_file.next_image()); */
-
-    return images;
-}
-
 void Application::read_images() {
-    auto const all_images = get_all_images();
-    for (auto &images : mnist_images_)
-        images.clear();
-    for (auto &&image : all_images)
-        mnist_images_[image.digit()].emplace_back(std::move(image));
-}
-
-void Application::resize_points() {
-    float width = points_bottom_right_.x - points_top_left_.x;
-    float height = points_bottom_right_.y - points_top_left_.y;
-    float size_coef = 2.0f / 3.0f;
-    point src_center(points_top_left_.x + width / 2, points_top_left_.y + height / 2);
-    point dest_center(digit_image::IMAGE_SIDE / 2.0f, digit_image::IMAGE_SIDE / 2.0f);
-    float coef = size_coef * (digit_image::IMAGE_SIDE - 1) / std::max(width, height);
-    for (auto &point : points_) {
-        point.x = dest_center.x + coef * (point.x - src_center.x);
-        point.y = dest_center.y + coef * (point.y - src_center.y);
-    }
+    training_set_ = std::make_unique<dataset>(TRAINING_IMAGES, TRAINING_LABELS);
 }
 
-Eigen::MatrixXf Application::get_digit_pixels_from_points() {
-    Eigen::MatrixXf pixels = Eigen::MatrixXf::Zero(digit_image::IMAGE_SIZE, 1);
-    for (auto &point : points_) {
-        size_t x = std::floor(point.x);
-        size_t y = std::floor(point.y);
-        size_t coeff = x + y * digit_image::IMAGE_SIDE;
-        assert(coeff < digit_image::IMAGE_SIZE);
-        pixels(coeff, 0) = 1.0f;
-        // Make more bold
-        for (x = x - 1; x <= point.x + 1; x += 2) {
-            if (x < 0 || x >= digit_image::IMAGE_SIDE)
-                continue;
-            for (y = y - 1; y <= point.y + 1; y += 2) {
-                if (y < 0 || y >= digit_image::IMAGE_SIDE)
-                    continue;
-                int coeff = x + y * digit_image::IMAGE_SIDE;
-                assert(coeff < digit_image::IMAGE_SIZE);
-                pixels(coeff, 0) = 1.0f;
-            }
-        }
-    }
-    return pixels;
+void Application::read_test_images() {
+    test_set_ = std::make_unique<dataset>("images/t10k-images.idx3-ubyte", "images/t10k-labels.idx1-ubyte");
 }
 
 void Application::draw_digit_to_stdout(Eigen::MatrixXf const &pixels) {
@@ -130,22 +135,40 @@ void Application::draw_digit_to_stdout(Eigen::MatrixXf const &pixels) {
 }
 
 void Application::train_on_digit() {
-    auto const pixels = get_digit_pixels_from_points();
+    auto const &pixels = canvas_.pixels();
     draw_digit_to_stdout(pixels);
-    std::cout << "Before:\n" << nn_.feed_forward(pixels).format(Eigen::IOFormat(4)) << "\n\n";
-    nn_.train(training_on_digit_, pixels);
-    std::cout << "After:\n" << nn_.feed_forward(pixels).format(Eigen::IOFormat(4)) << "\n\n";
+    if (online_trainer_->correct(training_on_digit_, pixels))
+        std::cout << "fine-tuning on digit " << training_on_digit_ << " in the background\n";
+    else
+        std::cout << "still fine-tuning, digit " << training_on_digit_ << " dropped\n";
 
     training_on_digit_ = -1;
 }
 
 void Application::recognize_digit() {
-    auto const pixels = get_digit_pixels_from_points();
+    auto const &pixels = canvas_.pixels();
     draw_digit_to_stdout(pixels);
+    Eigen::MatrixXf const ys = online_trainer_->read([&](neural_network const &nn) {
+        return nn.feed_forward(pixels, workspace_);
+    });
+    Eigen::Index digit;
+    ys.col(0).maxCoeff(&digit);
     std::cout
         << '\n'
-        << nn_.feed_forward(pixels).format(Eigen::IOFormat(4)) << '\n'
-        << nn_.get_digit(pixels) << '\n';
+        << ys.format(Eigen::IOFormat(4)) << '\n'
+        << digit << '\n';
+}
+
+void Application::update_prediction() {
+    predicted_version_ = online_trainer_->version();
+    Eigen::Index digit;
+    auto const score = online_trainer_->read([&](neural_network const &nn) {
+        return nn.feed_forward(canvas_.pixels(), workspace_).col(0).maxCoeff(&digit);
+    });
+    std::ostringstream title;
+    title << "Digit Input: " << digit << " (" << std::fixed << std::setprecision(2) << score << ')';
+    glutSetWindowTitle(title.str().c_str());
+    predicted_points_ = canvas_.points().size();
 }
 
 void Application::reshape(int width, int height) {
@@ -164,35 +187,24 @@ void Application::display() {
 }
 
 void Application::display(bool) {
-    if (points_.size() == 0) {
-        glClearColor(1, 1, 1, 1);
-        glClear(GL_COLOR_BUFFER_BIT);
-    }
+    auto const &points = canvas_.points();
+    // at most one forward pass per frame, however many motion events came
+    if (points.size() != predicted_points_ || online_trainer_->version() != predicted_version_)
+        update_prediction();
+
+    glClearColor(1, 1, 1, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
 
     glPointSize(1.0);
     glColor3f(0, 0, 0);
     glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(2, GL_FLOAT, sizeof(point), points_.data());
-    glDrawArrays(GL_POINTS, 0, points_.size());
+    glVertexPointer(2, GL_FLOAT, sizeof(canvas::point), points.data());
+    glDrawArrays(GL_POINTS, 0, points.size());
     glDisableClientState(GL_VERTEX_ARRAY);
 
     glFlush();
 }
 
-void Application::update_input_bounds(float x, float y) {
-    points_top_left_.x = std::min(points_top_left_.x, x);
-    points_top_left_.y = std::min(points_top_left_.y, y);
-    points_bottom_right_.x = std::max(points_bottom_right_.x, x);
-    points_bottom_right_.y = std::max(points_bottom_right_.y, y);
-}
-
-void Application::reset_input_bounds() {
-    points_top_left_.x = std::numeric_limits<float>::max();
-    points_top_left_.y = std::numeric_limits<float>::max();
-    points_bottom_right_.x = 0;
-    points_bottom_right_.y = 0;
-}
-
 void Application::mouse(int button, int state, int x, int y) {
     get_instance().mouse(button, state, x, y, true);
 }
@@ -201,16 +213,15 @@ void Application::mouse(int button, int state, int x, int y, bool) {
     switch (button) {
         case GLUT_LEFT_BUTTON:
             if (state == GLUT_DOWN) {
-                points_.clear();
-                update_input_bounds(x, y);
+                canvas_.clear();
+                predicted_points_ = 0;
+                glutSetWindowTitle("Digit Input");
             } else {
-                resize_points();
                 if (training_on_digit_ >= 0 && training_on_digit_ <= 9) {
                     train_on_digit();
                 } else {
                     recognize_digit();
                 }
-                reset_input_bounds();
             }
             break;
     }
@@ -223,11 +234,21 @@ void Application::motion(int x, int y) {
 }
 
 void Application::motion(int x, int y, bool) {
-    points_.emplace_back(x, y);
-    update_input_bounds(x, y);
+    canvas_.add_point(x, y);
     glutPostRedisplay();
 }
 
+void Application::poll(int value) {
+    get_instance().poll(value, true);
+}
+
+void Application::poll(int, bool) {
+    // the trainer thread can't post a redisplay itself
+    if (online_trainer_->version() != predicted_version_)
+        glutPostRedisplay();
+    glutTimerFunc(100, poll, 0);
+}
+
 void Application::keyboard(unsigned char key, int x, int y) {
     get_instance().keyboard(key, x, y, true);
 }
@@ -236,6 +257,7 @@ void Application::keyboard(unsigned char key, int, int, bool) {
     switch (key) {
     case 'x':
         std::cout << "exiting & saving coefficients" << std::endl;
+        online_trainer_->read([&](neural_network const &nn) { nn_.copy_coefficients(nn); });
         write_coefficients();
     case 'q':
         exit(2);
@@ -261,7 +283,7 @@ void Application::keyboard(unsigned char key, int, int, bool) {
 }
 
 void Application::read_coefficients() {
-    std::ifstream coefficients(coefficients_path_, std::ifstream::in);
+    std::ifstream coefficients(coefficients_path_, std::ifstream::in | std::ifstream::binary);
     if (coefficients.is_open()) {
         coefficients.exceptions(std::ifstream::badbit | std::ifstream::failbit);
         nn_.read_coefficients(coefficients);
@@ -274,52 +296,150 @@ void Application::read_coefficients() {
 }
 
 void Application::write_coefficients() {
+    write_coefficients(coefficients_path_, options_.format);
+}
+
+void Application::write_coefficients(std::string const &path, coefficients_format format) {
+    telemetry::scoped_timer timer(telemetry::phase::checkpoint);
     std::ofstream coefficients;
     coefficients.exceptions(std::ofstream::badbit | std::ofstream::failbit);
-    coefficients.open(coefficients_path_, std::ofstream::out | std::ofstream::trunc);
-    nn_.save_coefficients(coefficients);
+    coefficients.open(path, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    switch (format) {
+        case coefficients_format::binary:
+            nn_.save_binary_coefficients(coefficients);
+            break;
+        case coefficients_format::text:
+            nn_.save_coefficients(coefficients);
+            break;
+    }
     coefficients.close();
 }
 
-digit_image const& Application::get_random_image(int digit) {
-    return mnist_images_[digit][random_(random_engine_) % mnist_images_[digit].size()];
+size_t Application::get_random_image(int digit) {
+    auto const &indices = training_set_->indices(digit);
+    return indices[random_(random_engine_) % indices.size()];
 }
 
-void Application::run_training() {
-    read_images();
+std::unique_ptr<evaluator> Application::get_evaluator() {
+    try {
+        read_test_images();
+        return std::make_unique<evaluator>(*test_set_);
+    } catch (std::exception const &e) {
+        std::cerr << "t10k test set is not available (" << e.what() << "), evaluating on training images\n";
+    }
 
-    std::vector<digit_image const*> test_set;
+    std::vector<uint32_t> test_set;
     for (size_t tests = 0; tests < 100; tests++) {
-        for (size_t digit = 0; digit < 10; digit++) {
-            auto const &image = get_random_image(digit);
-            test_set.push_back(&image);
-        }
+        for (size_t digit = 0; digit < 10; digit++)
+            test_set.push_back(get_random_image(digit));
     }
+    return std::make_unique<evaluator>(*training_set_, std::move(test_set));
+}
+
+Eigen::MatrixXf Application::get_calibration() {
+    auto const calibration_size = std::min(options_.calibration_size, training_set_->size());
+    Eigen::MatrixXf calibration(digit_image::IMAGE_SIZE, calibration_size);
+    for (size_t i = 0; i < calibration_size; i++)
+        training_set_->get_pixels(i, calibration.col(i));
+    return calibration;
+}
 
+void Application::run_training() {
+    read_images();
+    auto const test_set = get_evaluator();
+
+    size_t const samples_per_epoch = 10000;
+    trainer trainer(nn_, pool_, options_.parallel, options_.batch_size);
+    // whole batches, and one per thread for hogwild
+    auto const chunk = options_.batch_size * (options_.parallel == trainer::mode::hogwild ? pool_.size() : 1);
+    auto const block_size = (std::max<size_t>(256, chunk) + chunk - 1) / chunk * chunk;
+    augmenter const augmenter({}, random_engine_());
+    batch_loader loader(*training_set_, samples_per_epoch, block_size, options_.prefetch, options_.loaders,
+                        options_.replacement, random_engine_(), options_.augment ? &augmenter : nullptr);
+
+    nn_.set_optimizer(options_.optimizer);
     size_t epoch = 0;
-    float rmse;
+    if (!options_.resume.empty()) {
+        auto const state = checkpointer::read(options_.resume, nn_);
+        epoch = state.epoch;
+        options_.learning_rate = state.learning_rate;
+        options_.decay = state.decay;
+        std::cout << "resuming " << options_.resume << " after epoch " << epoch << '\n';
+    }
+    std::unique_ptr<checkpointer> checkpoints;
+    if (options_.checkpoint_epochs || options_.checkpoint_seconds > 0.0f)
+        checkpoints = std::make_unique<checkpointer>(nn_, coefficients_path_, options_.keep_checkpoints);
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    auto const start = last_checkpoint;
+    float training_seconds = 0.0f;
+    bool reached = false;
+
+    float loss, target_loss;
     do {
-        nn_.set_learning_rate(1.0f / (1.0f + 0.5f * epoch));
-        for (size_t trainings = 0; trainings < 1000; trainings++) {
-            for (size_t digit = 0; digit < 10; digit++) {
-                auto const &image = get_random_image(digit);
-                nn_.train(image.digit(), image.pixels());
-            }
+        nn_.set_learning_rate(options_.learning_rate / (1.0f + options_.decay * epoch));
+        auto const training_start = std::chrono::steady_clock::now();
+        while (true) {
+            auto const &block = loader.next();
+            trainer.train(block.digits.head(block.count), block.x.leftCols(block.count));
+            if (block.last)
+                break;
         }
-        rmse = 0.0f;
-        size_t correct = 0;
-        for (auto const image : test_set) {
-            if (nn_.get_digit(image->pixels()) == image->digit())
-                correct++;
-            auto error = nn_.get_error(image->digit(), image->pixels());
-            rmse += error.cwiseProduct(error).sum();
-        }
-        rmse = std::sqrt(rmse / test_set.size());
-        std::cout << '[' << epoch << "]\t" << nn_.get_learning_rate() << '\t' << correct << '\t' << rmse << '\n';
+        std::chrono::duration<float> const training_time = std::chrono::steady_clock::now() - training_start;
+        training_seconds += training_time.count();
+        auto const result = evaluate(*test_set);
+        loss = result.loss();
+        target_loss = result.target_loss();
+        std::cout
+            << '[' << epoch << "]\t" << nn_.get_learning_rate() << '\t' << result.correct << '\t' << loss
+            << '\t' << samples_per_epoch / training_time.count() << " samples/s"
+            << '\t' << result.images_per_second() << " images/s\n";
+        telemetry::write_epoch({
+            {"epoch", epoch},
+            {"learning_rate", nn_.get_learning_rate()},
+            {"correct", result.correct},
+            {result.loss_name(), loss},
+            {"samples_per_second", samples_per_epoch / training_time.count()},
+        });
         epoch++;
-    } while (rmse > 0.2f && epoch < 300);
+        reached = options_.target_accuracy > 0.0f && result.accuracy() >= options_.target_accuracy;
+        if (reached) {
+            std::chrono::duration<float> const wall = std::chrono::steady_clock::now() - start;
+            std::cout
+                << "reached accuracy " << result.accuracy() << " with " << optimizer_name(options_.optimizer.kind)
+                << " after " << epoch << " epochs, " << training_seconds << " s training, " << wall.count() << " s total\n";
+        }
+
+        if (checkpoints) {
+            std::chrono::duration<float> const since_checkpoint = std::chrono::steady_clock::now() - last_checkpoint;
+            if ((options_.checkpoint_epochs && epoch % options_.checkpoint_epochs == 0)
+                || (options_.checkpoint_seconds > 0.0f && since_checkpoint.count() >= options_.checkpoint_seconds))
+            {
+                checkpoints->save(nn_, {epoch, options_.learning_rate, options_.decay});
+                last_checkpoint = std::chrono::steady_clock::now();
+            }
+        }
+    } while (options_.target_accuracy > 0.0f ? !reached && epoch < 300 : loss > target_loss && epoch < 300);
+
+    auto const result = evaluate(*test_set);
+    std::cout
+        << "accuracy " << result.accuracy() << " (" << result.correct << '/' << result.images << ")"
+        << ", " << result.loss_name() << ' ' << result.loss() << '\n';
+    result.print_confusion(std::cout);
 
     write_coefficients();
+    // the final evaluation and the write, without training
+    telemetry::write_epoch({
+        {"epoch", epoch},
+        {"learning_rate", nn_.get_learning_rate()},
+        {"correct", result.correct},
+        {result.loss_name(), result.loss()},
+        {"samples_per_second", 0.0},
+    });
+}
+
+evaluation Application::evaluate(evaluator &test_set) {
+    telemetry::scoped_timer timer(telemetry::phase::evaluation);
+    return test_set.evaluate(nn_, pool_);
 }
 
 void Application::initialize_gui() {
@@ -334,8 +454,7 @@ void Application::initialize_gui() {
     glutMouseFunc(mouse);
     glutMotionFunc(motion);
     glutKeyboardFunc(keyboard);
-
-    reset_input_bounds();
+    glutTimerFunc(100, poll, 0);
 }
 
 void Application::run_digit_input() {
@@ -343,7 +462,32 @@ void Application::run_digit_input() {
 }
 
 void Application::run_debugging() {
-    read_images();
+    std::unique_ptr<mapped_network> mapped;
+    std::unique_ptr<quantized_network> quantized;
+    quantized_network::workspace quantized_ws;
+    std::unique_ptr<sparse_network> sparse;
+    sparse_network::workspace sparse_ws;
+    {
+        std::ifstream coefficients(coefficients_path_, std::ifstream::in | std::ifstream::binary);
+        if (coefficients.is_open() && coefficient_file::is_binary(coefficients)) {
+            mapped = std::make_unique<mapped_network>(coefficients_path_);
+            check_digit_topology(mapped->inputs(), mapped->outputs());
+        } else if (coefficients.is_open() && quantized_network::is_quantized(coefficients)) {
+            coefficients.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+            quantized = std::make_unique<quantized_network>(coefficients);
+            check_digit_topology(quantized->inputs(), quantized->outputs());
+        } else if (coefficients.is_open() && sparse_network::is_sparse(coefficients)) {
+            coefficients.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+            sparse = std::make_unique<sparse_network>(coefficients);
+            check_digit_topology(sparse->inputs(), sparse->outputs());
+        }
+    }
+    if (mapped == nullptr && quantized == nullptr && sparse == nullptr)
+        read_coefficients();
+
+    // only the shown images are read
+    mnist_file images(TRAINING_IMAGES, TRAINING_LABELS);
+    label_index const index(TRAINING_LABELS);
 
     while (true) {
         int digit;
@@ -352,17 +496,327 @@ void Application::run_debugging() {
             continue;
         if (std::cin.eof())
             break;
+        if (index.count(digit) == 0)
+            continue;
 
-        auto const &image = get_random_image(digit);
-        int recognized = nn_.get_digit(image.pixels());
-        draw_digit_to_stdout(image.pixels());
+        auto const image = images.read_image(index.image(digit, random_(random_engine_) % index.count(digit)));
+        auto const &pixels = image.pixels();
+        int recognized = mapped ? mapped->get_digit(pixels)
+            : quantized ? quantized->get_digit(pixels, quantized_ws)
+            : sparse ? sparse->get_digit(pixels, sparse_ws)
+            : nn_.get_digit(pixels);
+        draw_digit_to_stdout(pixels);
         std::cout << recognized << '\n';
     }
 }
 
+void Application::run_converting() {
+    if (options_.output.empty())
+        throw std::runtime_error("convert requires --output");
+    write_coefficients(options_.output, options_.format);
+}
+
+void Application::run_quantizing() {
+    if (options_.output.empty())
+        throw std::runtime_error("quantize requires --output");
+
+    read_images();
+    auto const calibration = get_calibration();
+    quantized_network const quantized(nn_, calibration);
+    {
+        std::ofstream output;
+        output.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        output.open(options_.output, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+        quantized.save(output);
+    }
+
+    auto const test_set = get_evaluator();
+    auto const float_result = test_set->evaluate(nn_, pool_);
+    std::vector<quantized_network::workspace> workspaces(pool_.size());
+    auto const int8_result = test_set->evaluate(pool_, [&](auto const &pixels, size_t thread) {
+        return quantized.feed_forward(pixels, workspaces[thread]);
+    }, output_loss(nn_.activations().back()));
+
+    // single image latency, as in interactive recognition
+    size_t const repeats = 1000;
+    auto const pixels = training_set_->get_pixels(0);
+    auto const latency = [&](auto const &get_digit) {
+        auto const start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < repeats; i++)
+            get_digit();
+        std::chrono::duration<float, std::micro> const elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / repeats;
+    };
+    auto const float_latency = latency([&] { return nn_.get_digit(pixels); });
+    auto const int8_latency = latency([&] { return quantized.get_digit(pixels, workspaces.front()); });
+
+    size_t float_size = 0;
+    for (size_t layer = 1; layer < nn_.layer_sizes().size(); layer++)
+        float_size += (nn_.weights(layer).size() + nn_.biases(layer).size()) * sizeof(float);
+
+    std::cout
+        << "calibrated on " << calibration.cols() << " images, wrote " << options_.output << '\n'
+        << "\tfloat32\tint8\n"
+        << "accuracy\t" << float_result.accuracy() << '\t' << int8_result.accuracy() << '\n'
+        << float_result.loss_name() << '\t' << float_result.loss() << '\t' << int8_result.loss() << '\n'
+        << "images/s\t" << float_result.images_per_second() << '\t' << int8_result.images_per_second() << '\n'
+        << "latency us\t" << float_latency << '\t' << int8_latency << '\n'
+        << "bytes\t" << float_size << '\t' << quantized.coefficients_size() << '\n';
+}
+
+void Application::run_serving() {
+    server server(nn_, options_.serving);
+    if (options_.socket.empty())
+        server.serve(STDIN_FILENO, STDOUT_FILENO);
+    else
+        server.listen(options_.socket);
+}
+
+void Application::run_ensemble() {
+    std::vector<neural_network> members;
+    std::vector<std::string> paths;
+    std::stringstream list(coefficients_path_);
+    for (std::string path; std::getline(list, path, ',');) {
+        std::ifstream coefficients;
+        coefficients.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+        coefficients.open(path, std::ifstream::in | std::ifstream::binary);
+        members.push_back(nn_);
+        members.back().read_coefficients(coefficients);
+        paths.push_back(path);
+    }
+    ensemble_network const ensemble(members, options_.combination);
+    auto const outputs = nn_.layer_sizes().back();
+    auto const loss = output_loss(members.front().activations().back());
+
+    read_images();
+    auto const test_set = get_evaluator();
+    for (size_t k = 0; k < members.size(); k++)
+        std::cout << paths[k] << " accuracy " << test_set->evaluate(members[k], pool_).accuracy() << '\n';
+
+    // K networks one after another into the stacked outputs, combined the same way
+    std::vector<std::vector<neural_network::workspace>> separate_workspaces(pool_.size(), std::vector<neural_network::workspace>(members.size()));
+    std::vector<Eigen::MatrixXf> stacked(pool_.size());
+    std::vector<Eigen::MatrixXf> combined(pool_.size());
+    auto const separate = [&](Eigen::Ref<Eigen::MatrixXf const> const &pixels, size_t thread) {
+        auto &ys = stacked[thread];
+        ys.resize(members.size() * outputs, pixels.cols());
+        for (size_t k = 0; k < members.size(); k++)
+            ys.middleRows(k * outputs, outputs) = members[k].feed_forward(pixels, separate_workspaces[thread][k]);
+        combined[thread].resize(outputs, pixels.cols());
+        ensemble.combine(ys, combined[thread]);
+        return static_cast<Eigen::MatrixXf const&>(combined[thread]);
+    };
+    std::vector<ensemble_network::workspace> fused_workspaces(pool_.size());
+    auto const fused = [&](Eigen::Ref<Eigen::MatrixXf const> const &pixels, size_t thread) {
+        return ensemble.feed_forward(pixels, fused_workspaces[thread]);
+    };
+    auto const separate_result = test_set->evaluate(pool_, separate, loss);
+    auto const fused_result = test_set->evaluate(pool_, fused, loss);
+
+    // single image latency, as in interactive recognition
+    size_t const repeats = 1000;
+    auto const pixels = training_set_->get_pixels(0);
+    auto const latency = [&](auto const &forward) {
+        auto const start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < repeats; i++)
+            forward(pixels, 0);
+        std::chrono::duration<float, std::micro> const elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / repeats;
+    };
+    auto const separate_latency = latency(separate);
+    auto const fused_latency = latency(fused);
+
+    size_t separate_size = 0;
+    for (auto const &member : members)
+        for (size_t layer = 1; layer < member.layer_sizes().size(); layer++)
+            separate_size += (member.weights(layer).size() + member.biases(layer).size()) * sizeof(float);
+    // of one thread, as the evaluation left them
+    size_t separate_workspace = 0;
+    for (auto const &ws : separate_workspaces[0]) {
+        for (size_t layer = 1; layer < ws.as.size(); layer++)
+            separate_workspace += (ws.as[layer].size() + ws.errors[layer].size()
+                                   + ws.g.dws[layer].size() + ws.g.dbs[layer].size()) * sizeof(float);
+    }
+    separate_workspace += (stacked[0].size() + combined[0].size()) * sizeof(float);
+    size_t fused_workspace = fused_workspaces[0].y.size() * sizeof(float);
+    for (auto const &as : fused_workspaces[0].as)
+        fused_workspace += as.size() * sizeof(float);
+
+    std::cout
+        << members.size() << " members, "
+        << (options_.combination == ensemble_network::combination::vote ? "vote" : "average") << '\n'
+        << "\tseparate\tfused\n"
+        << "accuracy\t" << separate_result.accuracy() << '\t' << fused_result.accuracy() << '\n'
+        << fused_result.loss_name() << '\t' << separate_result.loss() << '\t' << fused_result.loss() << '\n'
+        << "images/s\t" << separate_result.images_per_second() << '\t' << fused_result.images_per_second() << '\n'
+        << "latency us\t" << separate_latency << '\t' << fused_latency << '\n'
+        << "coefficient bytes\t" << separate_size << '\t' << ensemble.coefficients_size() << '\n'
+        << "workspace bytes\t" << separate_workspace << '\t' << fused_workspace << '\n';
+}
+
+void Application::run_sweep() {
+    std::ifstream spec;
+    spec.exceptions(std::ifstream::badbit);
+    spec.open(coefficients_path_);
+    if (!spec.is_open())
+        throw std::runtime_error("failed to open sweep spec " + coefficients_path_);
+    sweep sweep(spec);
+
+    read_images();
+    // the shared test images, as training evaluates on them
+    dataset const *test = training_set_.get();
+    std::vector<uint32_t> test_indices;
+    try {
+        read_test_images();
+        test = test_set_.get();
+        test_indices.resize(test->size());
+        for (size_t i = 0; i < test_indices.size(); i++)
+            test_indices[i] = i;
+    } catch (std::exception const &e) {
+        std::cerr << "t10k test set is not available (" << e.what() << "), evaluating on training images\n";
+        for (size_t tests = 0; tests < 100; tests++) {
+            for (size_t digit = 0; digit < 10; digit++)
+                test_indices.push_back(get_random_image(digit));
+        }
+    }
+
+    std::cout << sweep.configurations().size() << " configurations on " << pool_.size() << " threads\n";
+    auto const start = std::chrono::steady_clock::now();
+    auto const results = sweep.run(*training_set_, *test, test_indices, pool_);
+    std::chrono::duration<float> const elapsed = std::chrono::steady_clock::now() - start;
+    sweep::print(std::cout, results);
+    std::cout << "swept in " << elapsed.count() << " s\n";
+    if (!results.empty())
+        std::cout << "best: train coefficients " << sweep::arguments(results.front().configuration) << '\n';
+}
+
+void Application::run_pruning() {
+    read_images();
+    auto const calibration = get_calibration();
+    auto const test_set = get_evaluator();
+    auto const loss = output_loss(nn_.activations().back());
+    size_t const samples_per_epoch = 10000;
+
+    // single image latency, as in interactive recognition
+    size_t const repeats = 1000;
+    auto const pixels = training_set_->get_pixels(0);
+    auto const latency = [&](auto const &get_digit) {
+        auto const start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < repeats; i++)
+            get_digit();
+        std::chrono::duration<float, std::micro> const elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / repeats;
+    };
+
+    auto const dense_result = test_set->evaluate(nn_, pool_);
+    neural_network::workspace dense_ws;
+    size_t dense_size = 0;
+    for (size_t layer = 1; layer < nn_.layer_sizes().size(); layer++)
+        dense_size += (nn_.weights(layer).size() + nn_.biases(layer).size()) * sizeof(float);
+
+    bool const tuned = options_.fine_tune_epochs > 0;
+    std::cout
+        << "pruning by " << pruning_name(options_.prune_by)
+        << (tuned ? ", fine-tuned for " + std::to_string(options_.fine_tune_epochs) + " epochs" : "") << '\n'
+        << "sparsity\tdensity\tcsr layers\t" << (tuned ? "pruned accuracy\t" : "") << "accuracy\t"
+        << dense_result.loss_name() << "\timages/s\tlatency us\tbytes\n"
+        << "dense\t1\t0\t" << (tuned ? "-\t" : "") << dense_result.accuracy() << '\t' << dense_result.loss()
+        << '\t' << dense_result.images_per_second() << '\t' << latency([&] {
+            Eigen::Index digit;
+            nn_.feed_forward(pixels, dense_ws).col(0).maxCoeff(&digit);
+            return digit;
+        })
+        << '\t' << dense_size << '\n';
+
+    for (size_t level = 0; level < options_.sparsities.size(); level++) {
+        auto const sparsity = options_.sparsities[level];
+        neural_network pruned = nn_;
+        prune(pruned, options_.prune_by, sparsity, calibration);
+
+        float pruned_accuracy = 0.0f;
+        if (tuned) {
+            pruned_accuracy = test_set->evaluate(pruned, pool_).accuracy();
+            trainer trainer(pruned, pool_, options_.parallel, options_.batch_size);
+            auto const chunk = options_.batch_size * (options_.parallel == trainer::mode::hogwild ? pool_.size() : 1);
+            auto const block_size = (std::max<size_t>(256, chunk) + chunk - 1) / chunk * chunk;
+            batch_loader loader(*training_set_, samples_per_epoch, block_size, options_.prefetch, options_.loaders,
+                                options_.replacement, random_engine_());
+            pruned.set_optimizer(options_.optimizer);
+            for (size_t epoch = 0; epoch < options_.fine_tune_epochs; epoch++) {
+                pruned.set_learning_rate(options_.learning_rate / (1.0f + options_.decay * epoch));
+                while (true) {
+                    auto const &block = loader.next();
+                    trainer.train(block.digits.head(block.count), block.x.leftCols(block.count));
+                    if (block.last)
+                        break;
+                }
+            }
+        }
+
+        sparse_network const sparse(pruned);
+        std::vector<sparse_network::workspace> workspaces(pool_.size());
+        auto const result = test_set->evaluate(pool_, [&](auto const &pixels, size_t thread) {
+            return sparse.feed_forward(pixels, workspaces[thread]);
+        }, loss);
+        std::cout
+            << sparsity << '\t' << sparse.density() << '\t' << sparse.sparse_layers() << '\t';
+        if (tuned)
+            std::cout << pruned_accuracy << '\t';
+        std::cout
+            << result.accuracy() << '\t' << result.loss() << '\t' << result.images_per_second()
+            << '\t' << latency([&] { return sparse.get_digit(pixels, workspaces.front()); })
+            << '\t' << sparse.coefficients_size() << '\n';
+
+        if (level + 1 == options_.sparsities.size() && !options_.output.empty()) {
+            std::ofstream output;
+            output.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+            output.open(options_.output, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+            sparse.save(output);
+            std::cout << "wrote " << options_.output << '\n';
+        }
+    }
+}
+
+void Application::run_exporting() {
+    if (options_.output.empty())
+        throw std::runtime_error("export requires --output");
+
+    // an image of every digit, or random pixels without the training set
+    Eigen::MatrixXf probes(digit_image::IMAGE_SIZE, 10);
+    try {
+        read_images();
+        for (int digit = 0; digit < 10; digit++)
+            training_set_->get_pixels(training_set_->indices(digit).at(0), probes.col(digit));
+    } catch (std::exception const &e) {
+        std::cerr << "probing with random pixels: " << e.what() << '\n';
+        probes = (Eigen::MatrixXf::Random(probes.rows(), probes.cols()).array() + 1.0f) / 2.0f;
+    }
+
+    exporter const exporter(nn_, probes);
+    auto const name = exporter::identifier(std::filesystem::path(options_.output).stem().string());
+    {
+        std::ofstream output;
+        output.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        output.open(options_.output, std::ofstream::out | std::ofstream::trunc);
+        exporter.write(output, name, std::filesystem::path(coefficients_path_).filename().string());
+    }
+    std::cout
+        << "wrote " << options_.output << ", namespace " << name << ", " << probes.cols() << " probes, "
+        << "largest difference to feed_forward " << exporter.difference() << '\n';
+}
+
 void Application::run_interactive() {
-    initialize_gui();
+    try {
+        read_images();
+    } catch (std::exception const &e) {
+        std::cerr << "fine-tuning without replayed images: " << e.what() << '\n';
+    }
     nn_.set_learning_rate(0.1f);
+    online_trainer::options options;
+    options.learning_rate = nn_.get_learning_rate();
+    options.seed = random_engine_();
+    online_trainer_ = std::make_unique<online_trainer>(nn_, training_set_.get(), options);
+    initialize_gui();
     run_digit_input();
 }
 
@@ -5,10 +5,30 @@
 #include <cmath>
 #include <random>
 #include <chrono>
+#include <fstream>
 
 #include "digit_image.h"
+#include "canvas.h"
 #include "neural_network.h"
+#include "dataset.h"
 #include "mnist_file.h"
+#include "label_index.h"
+#include "mapped_network.h"
+#include "coefficient_file.h"
+#include "evaluator.h"
+#include "thread_pool.h"
+#include "trainer.h"
+#include "batch_loader.h"
+#include "checkpointer.h"
+#include "server.h"
+#include "telemetry.h"
+#include "quantized_network.h"
+#include "online_trainer.h"
+#include "ensemble_network.h"
+#include "sweep.h"
+#include "pruning.h"
+#include "sparse_network.h"
+#include "exporter.h"
 
 class Application {
 public:
@@ -16,18 +36,76 @@ public:
         training,
         interactive,
         debugging,
+        converting,
+        quantizing,
+        serving,
+        // coefficients is a comma separated list of member files
+        ensembling,
+        // coefficients is a sweep spec
+        sweeping,
+        pruning,
+        // writes the network as a generated C++ header
+        exporting,
     };
 
-    struct point {
-        float x, y;
-        point() = default;
-        point(float x, float y)
-            : x(x)
-              , y(y)
-        {}
+    enum class coefficients_format {
+        binary,
+        text,
     };
 
-    Application(int argc, char *argv[], mode mode, std::string const &coefficients_path);
+    struct options {
+        size_t batch_size = 1;
+        float learning_rate = 1.0f;
+        // learning_rate / (1 + decay * epoch)
+        float decay = 0.5f;
+        std::vector<size_t> hidden{196, 49};
+        // 0 - one per hardware thread
+        size_t threads = 0;
+        trainer::mode parallel = trainer::mode::synchronous;
+        // sampling threads and the blocks of samples they prepare ahead
+        size_t loaders = 1;
+        size_t prefetch = 4;
+        // draw training images with replacement instead of once per epoch
+        bool replacement = false;
+        // random distortions of every training image on the loader threads
+        bool augment = false;
+        optimizer_settings optimizer;
+        // stops training once reached, otherwise at evaluation::target_loss
+        float target_accuracy = 0.0f;
+        coefficients_format format = coefficients_format::binary;
+        std::string output;
+        // of the hidden layers
+        activation hidden_activation = activation::sigmoid;
+        // sigmoid trained on squared error or softmax on cross-entropy
+        activation output_activation = activation::sigmoid;
+        // training images the int8 activation ranges and activity pruning
+        // are calibrated on
+        size_t calibration_size = 1000;
+        // pruning levels, all reported, the last one written to output
+        std::vector<float> sparsities{0.5f, 0.8f, 0.9f, 0.95f, 0.98f};
+        pruning prune_by = pruning::magnitude;
+        // training epochs of every pruned network, pruned weights stay zero
+        size_t fine_tune_epochs = 0;
+        // background checkpoints every so many epochs or seconds, off when 0
+        size_t checkpoint_epochs = 0;
+        float checkpoint_seconds = 0.0f;
+        size_t keep_checkpoints = 3;
+        // checkpoint to continue training from
+        std::string resume;
+        // serving on a Unix domain socket, stdin and stdout when empty
+        std::string socket;
+        server::options serving;
+        ensemble_network::combination combination = ensemble_network::combination::average;
+        // per-epoch telemetry, off when empty
+        std::string metrics;
+        bool hardware_counters = false;
+        // instruction set of the kernels, "auto" for the best the CPU supports
+        std::string isa = "auto";
+        // of the initial weights, sampling and augmentation, 0 - from the clock
+        uint64_t seed = 0;
+    };
+
+    Application(int argc, char *argv[], mode mode, std::string const &coefficients_path, options const &options);
     void run();
 
     static Application& get_instance() { return *instance_; };
@@ -38,6 +116,13 @@ private:
 
     void run_training();
     void run_debugging();
+    void run_converting();
+    void run_quantizing();
+    void run_serving();
+    void run_ensemble();
+    void run_sweep();
+    void run_pruning();
+    void run_exporting();
     void run_interactive();
 
     // glut
@@ -46,44 +131,57 @@ private:
     static void mouse(int button, int state, int x, int y);
     static void motion(int x, int y);
     static void keyboard(unsigned char key, int x, int y);
+    static void poll(int value);
 
     void reshape(int width, int height, bool);
     void display(bool);
     void mouse(int button, int state, int x, int y, bool);
     void motion(int x, int y, bool);
     void keyboard(unsigned char key, int x, int y, bool);
+    void poll(int value, bool);
 
-    std::vector<digit_image> get_all_images();
     void read_images();
-    digit_image const& get_random_image(int digit);
+    void read_test_images();
+    // index into training_set_
+    size_t get_random_image(int digit);
+    std::unique_ptr<evaluator> get_evaluator();
+    // the first calibration_size training images, one per column
+    Eigen::MatrixXf get_calibration();
+    evaluation evaluate(evaluator &test_set);
 
     void read_coefficients();
     void write_coefficients();
+    void write_coefficients(std::string const &path, coefficients_format format);
 
-    void resize_points();
-    Eigen::MatrixXf get_digit_pixels_from_points();
     void train_on_digit();
     void recognize_digit();
+    // shows the recognized digit in the window title
+    void update_prediction();
     void draw_digit_to_stdout(Eigen::MatrixXf const &pixels);
 
-    void update_input_bounds(float x, float y);
-    void reset_input_bounds();
-
     static Application *instance_;
 
     int argc_;
     char **argv_;
 
     mode mode_;
+    options options_;
     neural_network nn_;
     std::string coefficients_path_;
     std::default_random_engine random_engine_;
-    std::vector<digit_image> mnist_images_[10];
+    std::unique_ptr<dataset> training_set_;
+    std::unique_ptr<dataset> test_set_;
     std::uniform_int_distribution<size_t> random_;
+    thread_pool pool_;
 
     // manual_training, testing
-    point points_top_left_, points_bottom_right_;
-    std::vector<point> points_;
+    canvas canvas_;
+    neural_network::workspace workspace_;
+    // points and network version the shown prediction was made with
+    size_t predicted_points_;
+    uint64_t predicted_version_;
+    // fine-tunes on the digits drawn in interactive mode
+    std::unique_ptr<online_trainer> online_trainer_;
 
     int training_on_digit_;
     bool fixing_input_;
@@ -0,0 +1,120 @@
+#include "augmenter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+    constexpr int const SIDE = digit_image::IMAGE_SIDE;
+    using image_matrix = Eigen::Matrix<float, SIDE, SIDE>;
+    using row = Eigen::Array<float, SIDE, 1>;
+
+    // splitmix64, cheap to seed per sample
+    class sample_random {
+    public:
+        explicit sample_random(uint64_t seed)
+            : state_(seed)
+        {}
+
+        uint64_t next() {
+            uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        // in [-1, 1)
+        float symmetric() {
+            return (next() >> 40) * (2.0f / (1 << 24)) - 1.0f;
+        }
+
+    private:
+        uint64_t state_;
+    };
+}
+
+augmenter::augmenter(options const &options, uint64_t seed)
+    : options_(options)
+    , seed_(seed)
+{}
+
+void augmenter::augment(uint64_t sample, Eigen::Ref<Eigen::VectorXf> image) const {
+    assert(image.size() == digit_image::IMAGE_SIZE);
+    sample_random random(seed_ ^ (sample * 0xd1342543de82ef95ull));
+
+    // output pixel p samples the source at m (p - center) + center - shift + displacement
+    float const angle = options_.rotation * random.symmetric();
+    float const scale = 1.0f + options_.scale * random.symmetric();
+    float const shift_x = options_.shift * random.symmetric();
+    float const shift_y = options_.shift * random.symmetric();
+    float const m00 = std::cos(angle) / scale, m01 = std::sin(angle) / scale;
+    float const m10 = -m01, m11 = m00;
+    float const center = (SIDE - 1) / 2.0f;
+
+    Eigen::Matrix<float, GRID + 1, GRID + 1> grid_x, grid_y;
+    for (int i = 0; i < grid_x.size(); i++) {
+        grid_x(i) = options_.elastic * random.symmetric();
+        grid_y(i) = options_.elastic * random.symmetric();
+    }
+    bool const thicken = (random.next() >> 40) < options_.thickening * (1 << 24);
+
+    // the cell and the weight of its right or lower grid point, per coordinate
+    static auto const cells = [] {
+        std::pair<Eigen::Array<int, SIDE, 1>, row> cells;
+        for (int i = 0; i < SIDE; i++) {
+            float const position = i * static_cast<float>(GRID) / (SIDE - 1);
+            cells.first(i) = std::min(static_cast<int>(position), GRID - 1);
+            cells.second(i) = position - cells.first(i);
+        }
+        return cells;
+    }();
+    static row const xs = row::LinSpaced(SIDE, 0.0f, SIDE - 1.0f) - (SIDE - 1) / 2.0f;
+
+    image_matrix const source = Eigen::Map<image_matrix const>(image.data());
+    Eigen::Map<image_matrix> output(image.data());
+    auto const pixel = [&](int x, int y) {
+        return x >= 0 && x < SIDE && y >= 0 && y < SIDE ? source(x, y) : 0.0f;
+    };
+
+    row displacement_x, displacement_y;
+    for (int y = 0; y < SIDE; y++) {
+        // the grid interpolated to this row, then along it
+        int const cell = cells.first(y);
+        float const weight = cells.second(y);
+        Eigen::Matrix<float, GRID + 1, 1> const column_x = (1.0f - weight) * grid_x.col(cell) + weight * grid_x.col(cell + 1);
+        Eigen::Matrix<float, GRID + 1, 1> const column_y = (1.0f - weight) * grid_y.col(cell) + weight * grid_y.col(cell + 1);
+        for (int x = 0; x < SIDE; x++) {
+            int const c = cells.first(x);
+            float const w = cells.second(x);
+            displacement_x(x) = (1.0f - w) * column_x(c) + w * column_x(c + 1);
+            displacement_y(x) = (1.0f - w) * column_y(c) + w * column_y(c + 1);
+        }
+
+        float const dy = y - center;
+        row const source_x = m00 * xs + (m01 * dy + center - shift_x) + displacement_x;
+        row const source_y = m10 * xs + (m11 * dy + center - shift_y) + displacement_y;
+        row const floor_x = source_x.floor();
+        row const floor_y = source_y.floor();
+        row const fraction_x = source_x - floor_x;
+        row const fraction_y = source_y - floor_y;
+
+        // bilinear, zero outside the image
+        for (int x = 0; x < SIDE; x++) {
+            int const left = static_cast<int>(floor_x(x));
+            int const top = static_cast<int>(floor_y(x));
+            float const fx = fraction_x(x), fy = fraction_y(x);
+            output(x, y) =
+                (1.0f - fy) * ((1.0f - fx) * pixel(left, top) + fx * pixel(left + 1, top))
+                + fy * ((1.0f - fx) * pixel(left, top + 1) + fx * pixel(left + 1, top + 1));
+        }
+    }
+
+    if (thicken) {
+        // the maximum over each pixel and its four neighbours
+        image_matrix const thin = output;
+        output.topRows(SIDE - 1) = output.topRows(SIDE - 1).cwiseMax(thin.bottomRows(SIDE - 1));
+        output.bottomRows(SIDE - 1) = output.bottomRows(SIDE - 1).cwiseMax(thin.topRows(SIDE - 1));
+        output.leftCols(SIDE - 1) = output.leftCols(SIDE - 1).cwiseMax(thin.rightCols(SIDE - 1));
+        output.rightCols(SIDE - 1) = output.rightCols(SIDE - 1).cwiseMax(thin.leftCols(SIDE - 1));
+    }
+}
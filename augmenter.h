@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <Eigen/Eigen>
+
+#include "digit_image.h"
+
+// Random distortions of training images, generated on the fly.
+//
+// Every image is resampled once through the combination of a shift, a
+// rotation, a scale and an elastic displacement field, then its strokes are
+// thickened by chance. The displacement field interpolates random
+// displacements of a coarse grid, which is smooth without any filtering.
+// The distortion of a sample only depends on the seed and the sample number,
+// so it is the same for any number of threads.
+class augmenter {
+public:
+    struct options {
+        // at most, in pixels
+        float shift = 2.0f;
+        // at most, in radians
+        float rotation = 0.2f;
+        // the scale is within 1 -+ scale
+        float scale = 0.1f;
+        // displacement of the grid points at most, in pixels
+        float elastic = 1.0f;
+        // chance of thickening the strokes
+        float thickening = 0.3f;
+    };
+
+    // cells of the displacement grid per side
+    static constexpr int const GRID = 4;
+
+    augmenter(options const &options, uint64_t seed);
+
+    // distorts image, a column of digit_image::IMAGE_SIZE pixels, in place
+    void augment(uint64_t sample, Eigen::Ref<Eigen::VectorXf> image) const;
+
+private:
+    options options_;
+    uint64_t seed_;
+};
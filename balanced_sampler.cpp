@@ -0,0 +1,39 @@
+#include "balanced_sampler.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+balanced_sampler::balanced_sampler(dataset const &set, bool replacement, uint32_t seed)
+    : replacement_(replacement)
+    , random_(seed)
+{
+    std::iota(window_.begin(), window_.end(), 0);
+    for (int digit = 0; digit < 10; digit++) {
+        if (set.indices(digit).empty())
+            throw std::runtime_error("no training images of digit " + std::to_string(digit));
+        permutations_[digit] = set.indices(digit);
+        std::shuffle(permutations_[digit].begin(), permutations_[digit].end(), random_);
+        cursors_[digit] = 0;
+    }
+}
+
+uint32_t balanced_sampler::next(size_t position) {
+    position %= window_.size();
+    if (position == 0)
+        std::shuffle(window_.begin(), window_.end(), random_);
+    return pick(window_[position]);
+}
+
+uint32_t balanced_sampler::pick(int digit) {
+    auto &permutation = permutations_[digit];
+    if (replacement_)
+        return permutation[random_() % permutation.size()];
+
+    if (cursors_[digit] == permutation.size()) {
+        std::shuffle(permutation.begin(), permutation.end(), random_);
+        cursors_[digit] = 0;
+    }
+    return permutation[cursors_[digit]++];
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "dataset.h"
+
+// Picks training images so that every window of 10 samples holds each digit
+// once in a random order. Without replacement every digit walks through a
+// shuffled permutation of its images and reshuffles when it runs out, so no
+// image repeats within an epoch. The picks only depend on the seed.
+class balanced_sampler {
+public:
+    balanced_sampler(dataset const &set, bool replacement, uint32_t seed);
+
+    // the image of the position-th sample of an epoch, called for the
+    // positions in order
+    uint32_t next(size_t position);
+
+private:
+    uint32_t pick(int digit);
+
+    bool replacement_;
+    std::mt19937 random_;
+    std::array<int, 10> window_;
+    std::array<std::vector<uint32_t>, 10> permutations_;
+    std::array<size_t, 10> cursors_;
+};
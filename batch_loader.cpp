@@ -0,0 +1,103 @@
+#include "batch_loader.h"
+
+#include <algorithm>
+
+#include "telemetry.h"
+
+batch_loader::batch_loader(dataset const &set, size_t samples_per_epoch, size_t block_size,
+                           size_t capacity, size_t loaders, bool replacement, uint32_t seed,
+                           augmenter const *augmenter)
+    : set_(set)
+    , samples_per_epoch_(samples_per_epoch)
+    , block_size_(std::max<size_t>(block_size, 1))
+    , blocks_per_epoch_((samples_per_epoch + block_size_ - 1) / block_size_)
+    , augmenter_(augmenter)
+    , sampler_(set, replacement, seed)
+    , slots_(std::max<size_t>(capacity, 1))
+    , planned_(0)
+    , next_(0)
+    , released_(0)
+    , stopping_(false)
+{
+    for (auto &slot : slots_) {
+        slot.block.digits.resize(block_size_);
+        slot.block.x.resize(digit_image::IMAGE_SIZE, block_size_);
+    }
+    for (size_t i = 0; i < std::max<size_t>(loaders, 1); i++)
+        loaders_.emplace_back(&batch_loader::load, this);
+}
+
+batch_loader::~batch_loader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    freed_.notify_all();
+    for (auto &loader : loaders_)
+        loader.join();
+}
+
+batch_loader::block const& batch_loader::next() {
+    telemetry::scoped_timer timer(telemetry::phase::waiting);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // the previous block is done with
+    released_ = next_;
+    freed_.notify_all();
+
+    auto &slot = slots_[next_ % slots_.size()];
+    filled_.wait(lock, [&] { return slot.ready && slot.sequence == next_; });
+    slot.ready = false;
+    next_++;
+    return slot.block;
+}
+
+void batch_loader::load() {
+    std::vector<uint32_t> indices(block_size_);
+    while (true) {
+        uint64_t sequence;
+        size_t count;
+        bool last;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopping_)
+                return;
+            sequence = planned_++;
+            plan(sequence, indices, count, last);
+            freed_.wait(lock, [&] { return stopping_ || sequence < released_ + slots_.size(); });
+            if (stopping_)
+                return;
+        }
+
+        // the slot is ours until it is marked ready
+        auto &slot = slots_[sequence % slots_.size()];
+        {
+            telemetry::scoped_timer timer(telemetry::phase::sampling);
+            set_.get_batch(indices.data(), count, slot.block.x.leftCols(count));
+            for (size_t i = 0; i < count; i++)
+                slot.block.digits(i) = set_.digit(indices[i]);
+            slot.block.count = count;
+            slot.block.last = last;
+        }
+        if (augmenter_) {
+            telemetry::scoped_timer timer(telemetry::phase::augmentation);
+            for (size_t i = 0; i < count; i++)
+                augmenter_->augment(sequence * block_size_ + i, slot.block.x.col(i));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.sequence = sequence;
+            slot.ready = true;
+        }
+        filled_.notify_one();
+    }
+}
+
+void batch_loader::plan(uint64_t sequence, std::vector<uint32_t> &indices, size_t &count, bool &last) {
+    auto const block = sequence % blocks_per_epoch_;
+    auto const first = block * block_size_;
+    count = std::min(block_size_, samples_per_epoch_ - first);
+    last = block + 1 == blocks_per_epoch_;
+    for (size_t i = 0; i < count; i++)
+        indices[i] = sampler_.next(first + i);
+}
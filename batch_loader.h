@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "augmenter.h"
+#include "balanced_sampler.h"
+#include "dataset.h"
+
+// Prepares training samples on loader threads ahead of the trainer.
+//
+// Loaders fill a bounded ring of blocks of ready float samples, the trainer
+// takes them in order with next(). The images are picked class-balanced by
+// a balanced_sampler. The samples only depend on the seed, not on the number
+// of loaders. With an augmenter the loaders distort every sample, a
+// different way in every epoch.
+class batch_loader {
+public:
+    struct block {
+        Eigen::VectorXi digits;
+        // one sample per column
+        Eigen::MatrixXf x;
+        size_t count = 0;
+        // the last block of its epoch
+        bool last = false;
+    };
+
+    batch_loader(dataset const &set, size_t samples_per_epoch, size_t block_size,
+                 size_t capacity, size_t loaders, bool replacement, uint32_t seed,
+                 augmenter const *augmenter = nullptr);
+    ~batch_loader();
+
+    batch_loader(batch_loader const&) = delete;
+    batch_loader& operator=(batch_loader const&) = delete;
+
+    // Waits for the next block, which stays valid until the following call.
+    block const& next();
+
+private:
+    struct slot {
+        batch_loader::block block;
+        uint64_t sequence = 0;
+        bool ready = false;
+    };
+
+    void load();
+    // under mutex_, picks the images of a block in sequence order
+    void plan(uint64_t sequence, std::vector<uint32_t> &indices, size_t &count, bool &last);
+
+    dataset const &set_;
+    size_t samples_per_epoch_;
+    size_t block_size_;
+    size_t blocks_per_epoch_;
+    ::augmenter const *augmenter_;
+    balanced_sampler sampler_;
+
+    std::vector<slot> slots_;
+    std::vector<std::thread> loaders_;
+    std::mutex mutex_;
+    std::condition_variable filled_;
+    std::condition_variable freed_;
+    // the next sequence to plan and to return
+    uint64_t planned_;
+    uint64_t next_;
+    // sequences below are not in use by the trainer
+    uint64_t released_;
+    bool stopping_;
+};
@@ -0,0 +1,558 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "allocation_counter.h"
+#include "augmenter.h"
+#include "canvas.h"
+#include "dataset.h"
+#include "digit_image.h"
+#include "evaluator.h"
+#include "label_index.h"
+#include "kernels.h"
+#include "mnist_file.h"
+#include "neural_network.h"
+#include "pruning.h"
+#include "sparse_network.h"
+#include "static_network.h"
+#include "thread_pool.h"
+#include "trainer.h"
+
+// Headless benchmarks: make bench && ./nnnumber-bench [--seed N] [--threads N] [--json PATH] [--isa NAME]
+//
+// Every random input derives from the seed, so runs with the same seed
+// measure the same work. With --json every result is also written as one
+// JSON object per line for tracking regressions between versions. Exits
+// with 1 when a warm training or inference loop allocated.
+
+struct bench_options {
+    unsigned seed = 1;
+    size_t threads = 1;
+    std::string json;
+    // kernels of everything but bench_kernels, "auto" for the best supported
+    std::string isa = "auto";
+};
+
+static bench_options options;
+static std::ofstream json;
+
+static void report(std::string const &name, size_t iterations, size_t items, double ns_per_op);
+
+// items - the work of one operation, e.g. images per epoch, returns ns/op
+template <typename Function>
+static double measure(std::string const &name, size_t iterations, size_t items, Function &&function) {
+    // warm up caches and workspaces
+    for (size_t i = 0; i < iterations / 10 + 1; i++)
+        function();
+
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        function();
+    std::chrono::duration<double, std::nano> const elapsed = std::chrono::steady_clock::now() - start;
+    report(name, iterations, items, elapsed.count() / iterations);
+    return elapsed.count() / iterations;
+}
+
+static void report(std::string const &name, size_t iterations, size_t items, double ns_per_op) {
+    auto const items_per_second = items * 1e9 / ns_per_op;
+    std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << ns_per_op << " ns/op" << std::setw(14) << items_per_second << " items/s\n";
+    if (json.is_open()) {
+        json << "{\"benchmark\":\"" << name << "\",\"seed\":" << options.seed << ",\"threads\":" << options.threads
+             << ",\"iterations\":" << iterations << ",\"items\":" << items << std::fixed << std::setprecision(1)
+             << ",\"ns_per_op\":" << ns_per_op << ",\"items_per_second\":" << items_per_second << "}\n";
+    }
+}
+
+template <typename Function>
+static double measure(std::string const &name, size_t iterations, Function &&function) {
+    return measure(name, iterations, 1, std::forward<Function>(function));
+}
+
+static void write_uint32(std::ostream &os, uint32_t value) {
+    char const bytes[] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+    os.write(bytes, sizeof(bytes));
+}
+
+// Writes an IDX file pair of images with a bright block at a position
+// depending on the digit over uniform noise, so the digits are learnable.
+static void write_synthetic_images(std::string const &images_path, std::string const &labels_path, size_t count) {
+    std::mt19937 random(options.seed);
+    std::ofstream images(images_path, std::ofstream::binary);
+    std::ofstream labels(labels_path, std::ofstream::binary);
+    write_uint32(images, mnist_file::HEADER_TRAINING_FILE);
+    write_uint32(images, count);
+    write_uint32(images, digit_image::IMAGE_SIDE);
+    write_uint32(images, digit_image::IMAGE_SIDE);
+    write_uint32(labels, mnist_file::HEADER_LABEL_FILE);
+    write_uint32(labels, count);
+
+    std::vector<char> pixels(digit_image::IMAGE_SIZE);
+    for (size_t image = 0; image < count; image++) {
+        auto const digit = static_cast<int>(random() % 10);
+        for (auto &pixel : pixels)
+            pixel = random() % 64;
+        size_t const top = 4 + (digit / 5) * 10, left = 2 + (digit % 5) * 5;
+        for (size_t y = top; y < top + 10; y++)
+            for (size_t x = left; x < left + 5; x++)
+                pixels[x + y * digit_image::IMAGE_SIDE] = char(255);
+        images.write(pixels.data(), pixels.size());
+        labels.put(static_cast<char>(digit));
+    }
+}
+
+static void bench_network() {
+    srand(options.seed);
+    neural_network nn(0.1f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    Eigen::MatrixXf const x = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 1).array() + 1.0f) / 2.0f;
+    Eigen::MatrixXf const batch = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 16).array() + 1.0f) / 2.0f;
+    Eigen::VectorXi digits(16);
+    for (Eigen::Index i = 0; i < digits.size(); i++)
+        digits(i) = i % 10;
+
+    neural_network::workspace ws;
+    float sink = 0.0f;
+    measure("neural_network::feed_forward", 20000, [&] { sink += nn.feed_forward(x)(0); });
+    measure("neural_network::feed_forward workspace", 20000, [&] { sink += nn.feed_forward(x, ws)(0); });
+    measure("neural_network::feed_forward batch 16", 2000, 16, [&] { sink += nn.feed_forward(batch, ws)(0); });
+    measure("neural_network::get_digit", 20000, [&] { sink += nn.get_digit(x); });
+    measure("neural_network::train", 5000, [&] { nn.train(3, x); });
+    measure("neural_network::train_batch 16", 1000, 16, [&] { nn.train_batch(digits, batch); });
+    if (sink == 42.0f)
+        std::cout << '\n';
+}
+
+// Warm training and inference loops must not touch the heap, their buffers
+// live in workspaces. Returns whether none of them allocated.
+static bool check_allocations() {
+    srand(options.seed);
+    neural_network nn(0.1f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    Eigen::MatrixXf const x = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 1).array() + 1.0f) / 2.0f;
+    Eigen::MatrixXf const batch = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 64).array() + 1.0f) / 2.0f;
+    Eigen::VectorXi digits(64);
+    for (Eigen::Index i = 0; i < digits.size(); i++)
+        digits(i) = i % 10;
+
+    thread_pool pool(options.threads);
+    trainer synchronous(nn, pool, trainer::mode::synchronous, 16);
+    trainer hogwild(nn, pool, trainer::mode::hogwild, 16);
+    neural_network::workspace ws;
+    float sink = 0.0f;
+    bool allocation_free = true;
+    auto const check = [&](std::string const &name, auto &&function) {
+        for (int i = 0; i < 3; i++)
+            function();
+        auto const allocations = allocation_counter::count();
+        for (int i = 0; i < 100; i++)
+            function();
+        auto const count = allocation_counter::count() - allocations;
+        std::cout << std::left << std::setw(44) << "allocations " + name << std::right << std::setw(14) << count << '\n';
+        allocation_free = allocation_free && count == 0;
+    };
+    for (auto kind : {optimizer::sgd, optimizer::adam}) {
+        optimizer_settings settings;
+        settings.kind = kind;
+        nn.set_optimizer(settings);
+        auto const name = optimizer_name(kind);
+        check("train " + name, [&] { nn.train(3, x); });
+        check("train_batch 16 " + name, [&] { nn.train_batch(digits.head(16), batch.leftCols(16)); });
+        check("trainer sync 64 " + name, [&] { synchronous.train(digits, batch); });
+        check("trainer hogwild 64 " + name, [&] { hogwild.train(digits, batch); });
+    }
+    check("feed_forward workspace", [&] { sink += nn.feed_forward(x, ws)(0); });
+    check("feed_forward batch 64", [&] { sink += nn.feed_forward(batch, ws)(0); });
+    neural_network pruned = nn;
+    prune(pruned, pruning::magnitude, 0.98f, batch);
+    sparse_network const sparse(pruned);
+    sparse_network::workspace sparse_ws;
+    check("sparse feed_forward", [&] { sink += sparse.feed_forward(x, sparse_ws)(0); });
+    check("sparse feed_forward batch 64", [&] { sink += sparse.feed_forward(batch, sparse_ws)(0); });
+    if (sink == 42.0f)
+        std::cout << '\n';
+    if (!allocation_free)
+        std::cout << "  warm loops allocated\n";
+    return allocation_free;
+}
+
+// the same work on the kernels of every instruction set the CPU supports
+static void bench_kernels() {
+    srand(options.seed);
+    neural_network nn(0.1f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    Eigen::MatrixXf const batch = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 16).array() + 1.0f) / 2.0f;
+    Eigen::VectorXi digits(16);
+    for (Eigen::Index i = 0; i < digits.size(); i++)
+        digits(i) = i % 10;
+
+    auto const selected = kernels::selected();
+    neural_network::workspace ws;
+    float sink = 0.0f;
+    double forward_baseline = 0.0, train_baseline = 0.0;
+    for (auto isa : {kernels::isa::sse2, kernels::isa::avx2, kernels::isa::avx512}) {
+        if (!kernels::supported(isa))
+            continue;
+        kernels::select(isa);
+        auto const name = kernels::isa_name(isa);
+        auto const forward_ns = measure("kernels " + name + " feed_forward batch 16", 2000, 16,
+                                        [&] { sink += nn.feed_forward(batch, ws)(0); });
+        auto const train_ns = measure("kernels " + name + " train_batch 16", 1000, 16,
+                                      [&] { nn.train_batch(digits, batch); });
+        if (isa == kernels::isa::sse2) {
+            forward_baseline = forward_ns;
+            train_baseline = train_ns;
+        } else {
+            std::cout << std::fixed << std::setprecision(2)
+                      << "  " << name << " over sse2: feed_forward " << forward_baseline / forward_ns
+                      << "x, train_batch " << train_baseline / train_ns << "x\n" << std::defaultfloat;
+        }
+    }
+    kernels::select(selected);
+    if (sink == 42.0f)
+        std::cout << '\n';
+}
+
+// pruned by magnitude, the hidden layers forced into CSR against the
+// same network dense, where they cross is sparse_network::MAX_SPARSE_DENSITY
+static void bench_sparse_network() {
+    srand(options.seed);
+    neural_network nn(0.1f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    Eigen::MatrixXf const x = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 1).array() + 1.0f) / 2.0f;
+    Eigen::MatrixXf const batch = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 16).array() + 1.0f) / 2.0f;
+
+    float sink = 0.0f;
+    neural_network::workspace dense_ws;
+    measure("sparse_network dense feed_forward", 20000, [&] { sink += nn.feed_forward(x, dense_ws)(0); });
+    measure("sparse_network dense feed_forward batch 16", 2000, 16, [&] { sink += nn.feed_forward(batch, dense_ws)(0); });
+    for (float sparsity : {0.5f, 0.8f, 0.9f, 0.95f, 0.98f}) {
+        neural_network pruned = nn;
+        prune(pruned, pruning::magnitude, sparsity, batch);
+        // every pruned layer, the unpruned output layer stays dense
+        sparse_network const sparse(pruned, 0.99f);
+        sparse_network::workspace ws;
+        auto const difference = (sparse.feed_forward(batch, ws) - pruned.feed_forward(batch)).cwiseAbs().maxCoeff();
+        auto const name = "sparse_network csr " + std::to_string(static_cast<int>(sparsity * 100.0f + 0.5f)) + "%";
+        std::cout << name << " max output difference " << difference << '\n';
+        measure(name + " feed_forward", 20000, [&] { sink += sparse.feed_forward(x, ws)(0); });
+        measure(name + " feed_forward batch 16", 2000, 16, [&] { sink += sparse.feed_forward(batch, ws)(0); });
+    }
+    if (sink == 42.0f)
+        std::cout << '\n';
+}
+
+static void bench_static_network() {
+    using network = static_network<digit_image::IMAGE_SIZE, 196, 49, 10>;
+
+    srand(options.seed);
+    neural_network dynamic(0.1f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    network fixed(0.1f);
+    std::stringstream coefficients;
+    dynamic.save_binary_coefficients(coefficients);
+    fixed.read_coefficients(coefficients);
+
+    Eigen::MatrixXf const x = (Eigen::MatrixXf::Random(digit_image::IMAGE_SIZE, 1).array() + 1.0f) / 2.0f;
+    network::input const fixed_x = x;
+    float const difference = (dynamic.feed_forward(x) - fixed.feed_forward(fixed_x)).cwiseAbs().maxCoeff();
+    std::cout << "static_network max output difference " << difference << '\n';
+    dynamic.train(3, x);
+    fixed.train(3, fixed_x);
+    float const trained_difference = (dynamic.feed_forward(x) - fixed.feed_forward(fixed_x)).cwiseAbs().maxCoeff();
+    std::cout << "static_network max output difference after train " << trained_difference << '\n';
+
+    float sink = 0.0f;
+    measure("static_network::feed_forward", 20000, [&] { sink += fixed.feed_forward(fixed_x)(0); });
+    measure("static_network::get_digit", 20000, [&] { sink += fixed.get_digit(fixed_x); });
+    measure("static_network::train", 5000, [&] { fixed.train(3, fixed_x); });
+    if (sink == 42.0f)
+        std::cout << '\n';
+}
+
+static void bench_loader(std::string const &images_path, std::string const &labels_path, size_t count) {
+    size_t sink = 0;
+    measure("mnist_file::next_image", 5, count, [&] {
+        mnist_file file(images_path, labels_path);
+        while (file.has_next_image())
+            sink += file.next_image().digit();
+    });
+    measure("mnist_file::read_images", 20, count, [&] {
+        mnist_file file(images_path, labels_path);
+        std::vector<uint8_t> labels(file.image_count());
+        std::vector<uint8_t> pixels(file.image_count() * digit_image::IMAGE_SIZE);
+        file.read_images(labels.data(), pixels.data(), labels.size());
+        sink += labels[0];
+    });
+    measure("dataset load parse", 10, count, [&] {
+        std::filesystem::remove(dataset::cache_path(images_path));
+        dataset set(images_path, labels_path);
+        sink += set.size();
+    });
+    measure("dataset load cached", 100, count, [&] {
+        dataset set(images_path, labels_path);
+        sink += set.size();
+    });
+
+    // one image of a digit, as debug mode shows them
+    measure("label_index build", 100, count, [&] {
+        std::filesystem::remove(label_index::index_path(labels_path));
+        label_index index(labels_path);
+        sink += index.size();
+    });
+    measure("label_index load indexed", 1000, count, [&] {
+        label_index index(labels_path);
+        sink += index.size();
+    });
+    std::mt19937 random(options.seed);
+    {
+        mnist_file file(images_path, labels_path);
+        measure("mnist_file::read_image", 20000, [&] {
+            sink += file.read_image(random() % file.image_count()).digit();
+        });
+    }
+    measure("image of a digit cold, dataset cached", 100, [&] {
+        dataset set(images_path, labels_path);
+        sink += set.get_pixels(set.indices(3)[random() % set.indices(3).size()])(0) > 0.5f;
+    });
+    measure("image of a digit cold, indexed", 1000, [&] {
+        mnist_file file(images_path, labels_path);
+        label_index const index(labels_path);
+        sink += file.read_image(index.image(3, random() % index.count(3))).digit();
+    });
+    if (sink == 42)
+        std::cout << '\n';
+}
+
+static void bench_rasterizer() {
+    // a "0" stroke as the GUI delivers it: one point per motion event in a 128x128 window
+    canvas stroke;
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+    for (int i = 0; i < 200; i++) {
+        auto const angle = i * 2.0f * static_cast<float>(M_PI) / 200.0f;
+        stroke.add_point(64.0f + 30.0f * std::cos(angle) + jitter(random), 64.0f + 45.0f * std::sin(angle) + jitter(random));
+    }
+
+    float sink = 0.0f;
+    measure("canvas rasterize stroke of 200 points", 20000, [&] {
+        canvas drawing;
+        for (auto const &point : stroke.points())
+            drawing.add_point(point.x, point.y);
+        sink += drawing.pixels()(0);
+    });
+
+    // one live update while drawing: the next point and one inference
+    srand(options.seed);
+    neural_network nn(0.1f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    neural_network::workspace ws;
+    canvas drawing;
+    size_t next = 0;
+    measure("canvas::add_point + feed_forward", 20000, [&] {
+        if (next == stroke.points().size()) {
+            drawing.clear();
+            next = 0;
+        }
+        auto const &point = stroke.points()[next++];
+        drawing.add_point(point.x, point.y);
+        sink += nn.feed_forward(drawing.pixels(), ws)(0);
+    });
+    if (sink == 42.0f)
+        std::cout << '\n';
+}
+
+// Augmentation on one loader thread against training on options.threads, the
+// loaders needed for augmentation not to hold training up.
+static void bench_augmentation(std::string const &images_path, std::string const &labels_path) {
+    dataset const set(images_path, labels_path);
+    size_t const count = 1000;
+    std::vector<uint32_t> indices(count);
+    Eigen::VectorXi digits(count);
+    for (size_t i = 0; i < count; i++) {
+        indices[i] = i % set.size();
+        digits(i) = set.digit(indices[i]);
+    }
+    Eigen::MatrixXf images(digit_image::IMAGE_SIZE, count);
+    set.get_batch(indices.data(), count, images);
+
+    augmenter const augmenter({}, options.seed);
+    Eigen::MatrixXf augmented = images;
+    uint64_t epoch = 0;
+    auto const augment_ns = measure("augmenter::augment", 20, count, [&] {
+        augmented = images;
+        for (size_t i = 0; i < count; i++)
+            augmenter.augment(epoch * count + i, augmented.col(i));
+        epoch++;
+    });
+
+    Eigen::VectorXf first = images.col(0), second = images.col(0);
+    augmenter.augment(42, first);
+    augmenter.augment(42, second);
+    std::cout << "  same sample, same distortion: " << (first == second ? "yes" : "no") << '\n';
+
+    srand(options.seed);
+    neural_network nn(0.5f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+    thread_pool pool(options.threads);
+    trainer trainer(nn, pool, trainer::mode::synchronous, 16);
+    auto const train_ns = measure("train batch 16 augmented", 5, count, [&] {
+        trainer.train(digits, augmented);
+    });
+    std::cout << "  augmentation is " << train_ns / augment_ns << "x training throughput, "
+              << static_cast<int>(std::ceil(augment_ns / train_ns)) << " loader(s) keep up\n";
+}
+
+// one epoch as run_training does it: sampling, training and evaluation
+static void bench_epoch(std::string const &images_path, std::string const &labels_path) {
+    dataset const set(images_path, labels_path);
+    thread_pool pool(options.threads);
+    evaluator test_set(set);
+    size_t const samples_per_epoch = 10000;
+    Eigen::MatrixXf samples(digit_image::IMAGE_SIZE, samples_per_epoch);
+    Eigen::VectorXi digits(samples_per_epoch);
+
+    for (size_t batch_size : {size_t(1), size_t(16)}) {
+        srand(options.seed);
+        neural_network nn(batch_size == 1 ? 0.1f : 0.5f, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+        trainer trainer(nn, pool, trainer::mode::synchronous, batch_size);
+        std::mt19937 random(options.seed);
+        evaluation result;
+
+        measure("epoch batch " + std::to_string(batch_size), 3, samples_per_epoch, [&] {
+            for (size_t sample = 0; sample < samples_per_epoch; sample++) {
+                auto const &indices = set.indices(sample % 10);
+                auto const image = indices[random() % indices.size()];
+                set.get_pixels(image, samples.col(sample));
+                digits(sample) = set.digit(image);
+            }
+            trainer.train(digits, samples);
+            result = test_set.evaluate(nn, pool);
+        });
+        std::cout << "  accuracy after the last epoch " << result.accuracy() << '\n';
+    }
+}
+
+// Training time until an accuracy is reached, per optimizer at a learning
+// rate that suits it. Items are the samples trained on.
+static void bench_time_to_target(std::string const &images_path, std::string const &labels_path) {
+    dataset const set(images_path, labels_path);
+    thread_pool pool(options.threads);
+    evaluator test_set(set);
+    float const target = 0.99f;
+    size_t const samples_per_step = 500;
+    size_t const max_samples = 50000;
+    Eigen::MatrixXf samples(digit_image::IMAGE_SIZE, samples_per_step);
+    Eigen::VectorXi digits(samples_per_step);
+
+    std::pair<optimizer, float> const optimizers[] = {
+        {optimizer::sgd, 0.5f},
+        {optimizer::momentum, 0.05f},
+        {optimizer::nesterov, 0.05f},
+        {optimizer::rmsprop, 0.001f},
+        {optimizer::adam, 0.001f},
+    };
+    for (auto const &[kind, learning_rate] : optimizers) {
+        srand(options.seed);
+        neural_network nn(learning_rate, 4, digit_image::IMAGE_SIZE, size_t(196), size_t(49), size_t(10));
+        optimizer_settings settings;
+        settings.kind = kind;
+        nn.set_optimizer(settings);
+        trainer trainer(nn, pool, trainer::mode::synchronous, 16);
+        std::mt19937 random(options.seed);
+
+        size_t trained = 0;
+        std::chrono::duration<double, std::nano> elapsed(0);
+        float accuracy = 0.0f;
+        while (accuracy < target && trained < max_samples) {
+            auto const start = std::chrono::steady_clock::now();
+            for (size_t sample = 0; sample < samples_per_step; sample++) {
+                auto const &indices = set.indices(sample % 10);
+                auto const image = indices[random() % indices.size()];
+                set.get_pixels(image, samples.col(sample));
+                digits(sample) = set.digit(image);
+            }
+            trainer.train(digits, samples);
+            elapsed += std::chrono::steady_clock::now() - start;
+            trained += samples_per_step;
+            accuracy = test_set.evaluate(nn, pool).accuracy();
+        }
+        report("time to " + std::to_string(target).substr(0, 4) + " accuracy " + optimizer_name(kind), 1, trained, elapsed.count());
+        if (accuracy < target)
+            std::cout << "  not reached, accuracy " << accuracy << '\n';
+    }
+}
+
+static bool parse_options(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string const option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "missing value for " << option << '\n';
+            return false;
+        }
+        std::string const value = argv[++i];
+        try {
+            if (option == "--seed") {
+                options.seed = std::stoul(value);
+            } else if (option == "--threads") {
+                options.threads = std::stoul(value);
+            } else if (option == "--json") {
+                options.json = value;
+            } else if (option == "--isa") {
+                if (value != "auto")
+                    kernels::parse_isa(value);
+                options.isa = value;
+            } else {
+                std::cerr << "unknown option " << option << '\n';
+                return false;
+            }
+        } catch (std::exception const&) {
+            std::cerr << "invalid value for " << option << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parse_options(argc, argv)) {
+        std::cerr
+            << "usage: " << argv[0] << " [options]\n"
+            << "  --seed N     seed of all random inputs (default 1)\n"
+            << "  --threads N  threads of the epoch benchmark (default 1)\n"
+            << "  --json PATH  also write the results as JSON lines\n"
+            << "  --isa NAME   kernels for auto (default), sse2, avx2 or avx512\n";
+        return 1;
+    }
+    if (!options.json.empty()) {
+        json.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        json.open(options.json, std::ofstream::out | std::ofstream::trunc);
+    }
+
+    if (options.isa != "auto")
+        kernels::select(kernels::parse_isa(options.isa));
+    std::cout << "using " << kernels::isa_name(kernels::selected()) << " kernels\n";
+
+    bool const allocation_free = check_allocations();
+    bench_network();
+    bench_kernels();
+    bench_sparse_network();
+    bench_static_network();
+    bench_rasterizer();
+
+    // synthetic MNIST files, the benchmarks don't depend on the real data set
+    char directory[] = "/tmp/nnnumber-bench-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        throw std::runtime_error("failed to create a temporary directory");
+    std::string const images_path = std::string(directory) + "/images.idx3-ubyte";
+    std::string const labels_path = std::string(directory) + "/labels.idx1-ubyte";
+    size_t const images = 10000;
+    write_synthetic_images(images_path, labels_path, images);
+
+    bench_loader(images_path, labels_path, images);
+    bench_augmentation(images_path, labels_path);
+    bench_epoch(images_path, labels_path);
+    bench_time_to_target(images_path, labels_path);
+
+    std::filesystem::remove_all(directory);
+    return allocation_free ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include "canvas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+canvas::canvas()
+    : pixels_(Eigen::MatrixXf::Zero(digit_image::IMAGE_SIZE, 1))
+    , stale_(false)
+{
+    reset_bounds();
+}
+
+void canvas::clear() {
+    points_.clear();
+    pixels_.setZero();
+    stale_ = false;
+    reset_bounds();
+}
+
+void canvas::add_point(float x, float y) {
+    points_.emplace_back(x, y);
+    if (x >= top_left_.x && x <= bottom_right_.x && y >= top_left_.y && y <= bottom_right_.y) {
+        if (!stale_)
+            stamp(points_.back());
+        return;
+    }
+
+    top_left_.x = std::min(top_left_.x, x);
+    top_left_.y = std::min(top_left_.y, y);
+    bottom_right_.x = std::max(bottom_right_.x, x);
+    bottom_right_.y = std::max(bottom_right_.y, y);
+    update_transform();
+    stale_ = true;
+}
+
+Eigen::MatrixXf const& canvas::pixels() {
+    if (stale_)
+        rasterize();
+    return pixels_;
+}
+
+void canvas::reset_bounds() {
+    top_left_.x = std::numeric_limits<float>::max();
+    top_left_.y = std::numeric_limits<float>::max();
+    bottom_right_.x = std::numeric_limits<float>::lowest();
+    bottom_right_.y = std::numeric_limits<float>::lowest();
+}
+
+void canvas::update_transform() {
+    float const width = bottom_right_.x - top_left_.x;
+    float const height = bottom_right_.y - top_left_.y;
+    float const size_coef = 2.0f / 3.0f;
+    source_center_ = point(top_left_.x + width / 2, top_left_.y + height / 2);
+    // a single point doesn't divide by zero
+    scale_ = size_coef * (digit_image::IMAGE_SIDE - 1) / std::max({width, height, 1.0f});
+}
+
+void canvas::rasterize() {
+    pixels_.setZero();
+    for (auto const &point : points_)
+        stamp(point);
+    stale_ = false;
+}
+
+void canvas::stamp(point const &point) {
+    float const center = digit_image::IMAGE_SIDE / 2.0f;
+    int const x = std::floor(center + scale_ * (point.x - source_center_.x));
+    int const y = std::floor(center + scale_ * (point.y - source_center_.y));
+    int const side = digit_image::IMAGE_SIDE;
+    auto const set = [&](int x, int y) {
+        if (x >= 0 && x < side && y >= 0 && y < side)
+            pixels_(x + y * side, 0) = 1.0f;
+    };
+    set(x, y);
+    // Make more bold
+    set(x - 1, y - 1);
+    set(x + 1, y - 1);
+    set(x - 1, y + 1);
+    set(x + 1, y + 1);
+}
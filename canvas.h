@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "digit_image.h"
+
+// Points drawn with the mouse and their rasterization to a digit image.
+//
+// The image is kept up to date as points arrive. The points are scaled and
+// centered by their bounding box, a point within it is only stamped. One
+// growing it leaves the image to be rescaled once, when it is read next.
+class canvas {
+public:
+    struct point {
+        float x, y;
+        point() = default;
+        point(float x, float y)
+            : x(x)
+              , y(y)
+        {}
+    };
+
+    canvas();
+
+    // removes all points and clears the image
+    void clear();
+    void add_point(float x, float y);
+
+    std::vector<point> const& points() const { return points_; }
+    // one column of digit_image::IMAGE_SIZE pixels
+    Eigen::MatrixXf const& pixels();
+
+private:
+    void reset_bounds();
+    // maps the bounds to the middle 2/3 of the image
+    void update_transform();
+    void rasterize();
+    void stamp(point const &point);
+
+    point top_left_, bottom_right_;
+    // image = center_ + scale_ * (point - source_center_)
+    float scale_;
+    point source_center_;
+    std::vector<point> points_;
+    Eigen::MatrixXf pixels_;
+    // the bounds grew since the last rasterization
+    bool stale_;
+};
@@ -0,0 +1,157 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "coefficient_file.h"
+#include "ensemble_network.h"
+#include "label_index.h"
+#include "mnist_file.h"
+#include "quantized_network.h"
+#include "sparse_network.h"
+
+// Checks run by make check, ./nnnumber-check exits with 1 when any of them
+// fails.
+
+static int failures = 0;
+
+static void expect(bool condition, std::string const &what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << '\n';
+        failures++;
+    }
+}
+
+template <typename Function>
+static bool throws(Function &&function) {
+    try {
+        function();
+    } catch (std::exception const &) {
+        return true;
+    }
+    return false;
+}
+
+template <typename T>
+static void write(std::ostream &os, T const &value) {
+    os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+// a network file's magic, version and layer count, nothing after them
+static std::stringstream network_file(char const (&magic)[8], uint32_t version, uint32_t layers) {
+    std::stringstream file;
+    file.write(magic, sizeof(magic));
+    write(file, version);
+    write(file, layers);
+    return file;
+}
+
+static void check_zero_layer_files() {
+    auto quantized = network_file(quantized_network::MAGIC, quantized_network::VERSION, 0);
+    expect(throws([&] { quantized_network network(quantized); }), "a quantized network without layers is rejected");
+
+    auto sparse = network_file(sparse_network::MAGIC, sparse_network::VERSION, 0);
+    expect(throws([&] { sparse_network network(sparse); }), "a sparse network without layers is rejected");
+
+    std::stringstream coefficients;
+    coefficient_file::header const header = {
+        {'N', 'N', 'N', 'U', 'M', 'B', 'E', 'R'}, coefficient_file::VERSION, coefficient_file::DTYPE_FLOAT32, 0, 0};
+    write(coefficients, header);
+    expect(throws([&] { coefficient_file::read_header(coefficients); }), "a coefficient file without layers is rejected");
+    expect(throws([] { coefficient_file::check_layers(0); }), "check_layers rejects 0 layers");
+    expect(throws([] { coefficient_file::check_layers(coefficient_file::MAX_LAYERS + 1); }),
+           "check_layers rejects more than MAX_LAYERS");
+}
+
+// outputs outside [0, 1], as relu ones, still only break ties between votes
+static void check_vote_tie_break() {
+    std::vector<size_t> const sizes{4, 3};
+    neural_network member(0.1f, sizes);
+    member.set_activation(1, activation::relu);
+    ensemble_network const ensemble({member, member, member}, ensemble_network::combination::vote);
+
+    // two members vote 0, one votes 2 with a far larger score
+    Eigen::MatrixXf ys(9, 1);
+    ys << 1, 0, 0,
+          1, 0, 0,
+          0, 0, 100;
+    Eigen::MatrixXf y(3, 1);
+    ensemble.combine(ys, y);
+    Eigen::Index digit;
+    y.col(0).maxCoeff(&digit);
+    expect(digit == 0, "the most votes win over a large score");
+
+    // one vote each, the largest average breaks the tie
+    Eigen::MatrixXf tied(9, 1);
+    tied << 3, 0, 0,
+            0, 2, 0,
+            0, 0, 5;
+    ensemble.combine(tied, y);
+    y.col(0).maxCoeff(&digit);
+    expect(digit == 2, "the largest average breaks a tie");
+}
+
+// the index as a full scan of the labels would find it
+static void expect_label_index(label_index const &index, std::vector<uint8_t> const &labels, std::string const &what) {
+    expect(index.size() == labels.size(), what + " covers every label");
+    for (int digit = 0; digit < 10; digit++) {
+        std::vector<uint32_t> images;
+        for (uint32_t image = 0; image < labels.size(); image++) {
+            if (labels[image] == digit)
+                images.push_back(image);
+        }
+        bool same = index.count(digit) == images.size();
+        for (size_t i = 0; same && i < images.size(); i++)
+            same = index.image(digit, i) == images[i];
+        expect(same, what + " lists the images of digit " + std::to_string(digit) + " in file order");
+    }
+}
+
+static void check_label_index() {
+    char directory[] = "/tmp/nnnumber-check-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        throw std::runtime_error("failed to create a temporary directory");
+    std::string const labels_path = std::string(directory) + "/labels.idx1-ubyte";
+
+    // digit 7 has no image
+    std::mt19937 random(1);
+    std::vector<uint8_t> labels(1000);
+    for (auto &label : labels) {
+        label = random() % 9;
+        label += label == 7 ? 2 : 0;
+    }
+    std::ofstream file(labels_path, std::ofstream::binary);
+    for (uint32_t value : {mnist_file::HEADER_LABEL_FILE, static_cast<uint32_t>(labels.size())}) {
+        char const bytes[] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+        file.write(bytes, sizeof(bytes));
+    }
+    file.write(reinterpret_cast<char const*>(labels.data()), labels.size());
+    file.close();
+
+    {
+        label_index const built(labels_path);
+        expect_label_index(built, labels, "the built index");
+    }
+    expect(std::filesystem::exists(label_index::index_path(labels_path)), "the built index is written");
+    label_index const mapped(labels_path);
+    expect_label_index(mapped, labels, "the mapped index");
+
+    std::filesystem::remove_all(directory);
+}
+
+int main() {
+    check_zero_layer_files();
+    check_vote_tie_break();
+    check_label_index();
+    if (failures)
+        return 1;
+    std::cout << "all checks passed\n";
+    return 0;
+}
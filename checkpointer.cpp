@@ -0,0 +1,144 @@
+#include "checkpointer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "coefficient_file.h"
+#include "telemetry.h"
+
+static_assert(sizeof(checkpointer::header) <= coefficient_file::ALIGNMENT);
+
+checkpointer::checkpointer(neural_network const &nn, std::string const &path, size_t keep)
+    : path_(path)
+    , keep_(std::max<size_t>(keep, 1))
+    , pending_(-1)
+    , writing_(-1)
+    , stopping_(false)
+{
+    for (auto &snapshot : snapshots_)
+        snapshot.reset(new checkpointer::snapshot{nn, {}});
+    writer_ = std::thread(&checkpointer::run, this);
+}
+
+checkpointer::~checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pending_changed_.notify_one();
+    writer_.join();
+}
+
+void checkpointer::save(neural_network const &nn, state const &state) {
+    telemetry::scoped_timer timer(telemetry::phase::checkpoint);
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index = pending_ >= 0 ? pending_ : writing_ == 0;
+        pending_ = -1;
+    }
+
+    // not touched by the writer until it is pending
+    auto &snapshot = *snapshots_[index];
+    snapshot.nn.copy_coefficients(nn);
+    snapshot.state = state;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = index;
+    }
+    pending_changed_.notify_one();
+}
+
+void checkpointer::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pending_changed_.wait(lock, [this] { return stopping_ || pending_ >= 0; });
+            if (pending_ < 0)
+                return;
+            writing_ = pending_;
+            pending_ = -1;
+        }
+
+        try {
+            write(*snapshots_[writing_]);
+        } catch (std::exception const &e) {
+            // training goes on, the next checkpoint may succeed
+            std::cerr << "checkpoint failed: " << e.what() << '\n';
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        writing_ = -1;
+    }
+}
+
+void checkpointer::write(snapshot const &snapshot) {
+    telemetry::scoped_timer timer(telemetry::phase::checkpoint);
+    auto const path = path_ + '.' + std::to_string(snapshot.state.epoch) + ".ckpt";
+    auto const temporary_path = path + ".tmp";
+    {
+        std::ofstream os;
+        os.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        os.open(temporary_path, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+        header h{};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        h.optimizer = static_cast<uint32_t>(snapshot.nn.get_optimizer().kind);
+        h.epoch = snapshot.state.epoch;
+        h.learning_rate = snapshot.state.learning_rate;
+        h.decay = snapshot.state.decay;
+        os.write(reinterpret_cast<char const*>(&h), sizeof(h));
+        coefficient_file::write_padding(os, coefficient_file::ALIGNMENT - sizeof(h));
+        snapshot.nn.save_binary_coefficients(os);
+        snapshot.nn.save_optimizer_state(os);
+    }
+
+    // on disk before it replaces anything
+    int fd = open(temporary_path.c_str(), O_RDONLY);
+    if (fd < 0 || fsync(fd) < 0) {
+        if (fd >= 0)
+            close(fd);
+        throw std::runtime_error("failed to sync " + temporary_path);
+    }
+    close(fd);
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("failed to rename " + temporary_path);
+
+    if (written_.empty() || written_.back() != path)
+        written_.push_back(path);
+    while (written_.size() > keep_) {
+        std::remove(written_.front().c_str());
+        written_.pop_front();
+    }
+}
+
+checkpointer::state checkpointer::read(std::string const &path, neural_network &nn) {
+    std::ifstream is;
+    is.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+    is.open(path, std::ifstream::in | std::ifstream::binary);
+
+    header h;
+    is.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a checkpoint file");
+    if (h.version != VERSION)
+        throw std::runtime_error("unsupported checkpoint version " + std::to_string(h.version));
+    coefficient_file::skip_padding(is, coefficient_file::ALIGNMENT - sizeof(h));
+    nn.read_coefficients(is);
+    if (h.optimizer == static_cast<uint32_t>(nn.get_optimizer().kind))
+        nn.read_optimizer_state(is);
+    else
+        std::cerr << "resuming without the optimizer state of " << path << '\n';
+
+    state result;
+    result.epoch = h.epoch;
+    result.learning_rate = h.learning_rate;
+    result.decay = h.decay;
+    return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "neural_network.h"
+
+// Writes training checkpoints on a background thread.
+//
+// save() copies the weights into one of two snapshots and returns, the
+// writer thread writes the other one meanwhile. Files are written to a
+// temporary name, synced and renamed, so a checkpoint is either complete or
+// absent. Only the newest keep checkpoints of the run are kept.
+//
+// Checkpoint file, native byte order:
+//   header, padded to coefficient_file::ALIGNMENT
+//   binary coefficients file
+//   optimizer state, see neural_network::save_optimizer_state
+class checkpointer {
+public:
+    static constexpr char const MAGIC[8] = {'N', 'N', 'N', 'U', 'M', 'C', 'K', 'P'};
+    static constexpr uint32_t const VERSION = 1;
+
+    struct state {
+        // completed epochs
+        uint64_t epoch = 0;
+        // initial, the schedule decays it by epoch
+        float learning_rate = 0.0f;
+        // learning_rate / (1 + decay * epoch)
+        float decay = 0.0f;
+    };
+
+    struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t optimizer;
+        uint64_t epoch;
+        float learning_rate;
+        float decay;
+    };
+
+    // writes path.<epoch>.ckpt files
+    checkpointer(neural_network const &nn, std::string const &path, size_t keep);
+    // waits for the last checkpoint to be written
+    ~checkpointer();
+
+    checkpointer(checkpointer const&) = delete;
+    checkpointer& operator=(checkpointer const&) = delete;
+
+    // a snapshot still waiting for the writer is replaced
+    void save(neural_network const &nn, state const &state);
+
+    // Reads the weights into nn, and the optimizer state when nn uses the
+    // optimizer it was saved with.
+    static state read(std::string const &path, neural_network &nn);
+
+private:
+    struct snapshot {
+        neural_network nn;
+        checkpointer::state state;
+    };
+
+    void run();
+    void write(snapshot const &snapshot);
+
+    std::string path_;
+    size_t keep_;
+    std::unique_ptr<snapshot> snapshots_[2];
+    std::deque<std::string> written_;
+
+    std::mutex mutex_;
+    std::condition_variable pending_changed_;
+    // indices into snapshots_, -1 when none
+    int pending_;
+    int writing_;
+    bool stopping_;
+    std::thread writer_;
+};
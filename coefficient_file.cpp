@@ -0,0 +1,151 @@
+#include "coefficient_file.h"
+
+#include <cstring>
+#include <stdexcept>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "coefficient files are little-endian");
+
+static size_t align(size_t size) {
+    return (size + coefficient_file::ALIGNMENT - 1) / coefficient_file::ALIGNMENT * coefficient_file::ALIGNMENT;
+}
+
+bool coefficient_file::is_binary(std::istream &is) {
+    char magic[sizeof(MAGIC)] = {};
+    auto const position = is.tellg();
+    auto const exceptions = is.exceptions();
+    is.exceptions(std::istream::goodbit);
+    is.read(magic, sizeof(magic));
+    is.clear();
+    is.seekg(position);
+    is.exceptions(exceptions);
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// layer sizes and activations
+static size_t header_values(size_t layers) {
+    return 2 * layers;
+}
+
+size_t coefficient_file::header_size(size_t layers) {
+    return align(sizeof(header) + header_values(layers) * sizeof(uint32_t));
+}
+
+size_t coefficient_file::block_size(size_t count) {
+    return align(count * sizeof(float));
+}
+
+size_t coefficient_file::file_size(topology const &topology) {
+    auto const &layer_sizes = topology.layer_sizes;
+    auto size = header_size(layer_sizes.size());
+    for (size_t layer = 1; layer < layer_sizes.size(); layer++) {
+        size += block_size(layer_sizes[layer] * layer_sizes[layer - 1]);
+        size += block_size(layer_sizes[layer]);
+    }
+    return size;
+}
+
+void coefficient_file::check_header(header const &h) {
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a binary coefficients file");
+    if (h.version != VERSION)
+        throw std::runtime_error("unsupported coefficients file version " + std::to_string(h.version));
+    if (h.dtype != DTYPE_FLOAT32)
+        throw std::runtime_error("unsupported coefficients dtype " + std::to_string(h.dtype));
+    if (h.layers < 2)
+        throw std::runtime_error("invalid coefficients layer count");
+    check_layers(h.layers);
+}
+
+void coefficient_file::check_layers(uint64_t layers) {
+    if (layers == 0 || layers > MAX_LAYERS)
+        throw std::runtime_error("invalid layer count " + std::to_string(layers));
+}
+
+void coefficient_file::check_layer(uint64_t inputs, uint64_t outputs) {
+    if (inputs == 0 || outputs == 0 || inputs > MAX_LAYER_SIZE || outputs > MAX_LAYER_SIZE
+        || inputs * outputs > MAX_LAYER_WEIGHTS)
+    {
+        throw std::runtime_error("invalid layer size " + std::to_string(outputs) + 'x' + std::to_string(inputs));
+    }
+}
+
+coefficient_file::topology coefficient_file::get_topology(header const &h, uint32_t const *values) {
+    topology result;
+    result.layer_sizes.assign(values, values + h.layers);
+    for (size_t layer = 1; layer < h.layers; layer++)
+        check_layer(result.layer_sizes[layer - 1], result.layer_sizes[layer]);
+    result.activations.assign(h.layers, activation::sigmoid);
+    for (size_t layer = 1; layer < h.layers; layer++) {
+        auto const value = values[h.layers + layer];
+        if (value > static_cast<uint32_t>(activation::softmax))
+            throw std::runtime_error("invalid activation " + std::to_string(value));
+        result.activations[layer] = static_cast<activation>(value);
+    }
+    return result;
+}
+
+void coefficient_file::write_header(std::ostream &os, topology const &topology) {
+    auto const layers = topology.layer_sizes.size();
+    header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.dtype = DTYPE_FLOAT32;
+    h.layers = layers;
+    os.write(reinterpret_cast<char const*>(&h), sizeof(h));
+
+    std::vector<uint32_t> values;
+    for (auto size : topology.layer_sizes)
+        values.push_back(size);
+    for (auto activation : topology.activations)
+        values.push_back(static_cast<uint32_t>(activation));
+    values.resize(header_values(layers));
+    os.write(reinterpret_cast<char const*>(values.data()), values.size() * sizeof(uint32_t));
+    write_padding(os, header_size(layers) - sizeof(h) - values.size() * sizeof(uint32_t));
+}
+
+coefficient_file::topology coefficient_file::read_header(std::istream &is) {
+    header h;
+    is.read(reinterpret_cast<char*>(&h), sizeof(h));
+    check_header(h);
+
+    std::vector<uint32_t> values(header_values(h.layers));
+    is.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(uint32_t));
+    skip_padding(is, header_size(h.layers) - sizeof(h) - values.size() * sizeof(uint32_t));
+    return get_topology(h, values.data());
+}
+
+coefficient_file::topology coefficient_file::parse_header(void const *data, size_t size) {
+    header h;
+    if (size < sizeof(h))
+        throw std::runtime_error("truncated coefficients file");
+    std::memcpy(&h, data, sizeof(h));
+    check_header(h);
+    if (size < header_size(h.layers))
+        throw std::runtime_error("truncated coefficients file");
+
+    std::vector<uint32_t> values(header_values(h.layers));
+    std::memcpy(values.data(), static_cast<char const*>(data) + sizeof(h), values.size() * sizeof(uint32_t));
+    auto result = get_topology(h, values.data());
+    if (size < file_size(result))
+        throw std::runtime_error("truncated coefficients file");
+    return result;
+}
+
+void coefficient_file::write_block(std::ostream &os, float const *values, size_t count) {
+    os.write(reinterpret_cast<char const*>(values), count * sizeof(float));
+    write_padding(os, block_size(count) - count * sizeof(float));
+}
+
+void coefficient_file::read_block(std::istream &is, float *values, size_t count) {
+    is.read(reinterpret_cast<char*>(values), count * sizeof(float));
+    skip_padding(is, block_size(count) - count * sizeof(float));
+}
+
+void coefficient_file::write_padding(std::ostream &os, size_t size) {
+    static char const zeros[ALIGNMENT] = {};
+    os.write(zeros, size);
+}
+
+void coefficient_file::skip_padding(std::istream &is, size_t size) {
+    is.ignore(size);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "activation.h"
+
+// Binary coefficient file, all values little-endian:
+//
+//   header
+//   uint32_t layer sizes[header.layers]
+//   uint32_t layer activations[header.layers], the first one unused
+//   padding to ALIGNMENT
+//   for every layer 1 .. layers - 1:
+//       weights, float[size(layer) * size(layer - 1)] column-major, padded to ALIGNMENT
+//       biases, float[size(layer)], padded to ALIGNMENT
+//
+// Every block starts ALIGNMENT bytes into the file, so a mapped file can be
+// used in place.
+class coefficient_file {
+public:
+    static constexpr char const MAGIC[8] = {'N', 'N', 'N', 'U', 'M', 'B', 'E', 'R'};
+    static constexpr uint32_t const VERSION = 1;
+    static constexpr uint32_t const DTYPE_FLOAT32 = 1;
+    static constexpr size_t const ALIGNMENT = 64;
+    // bounds on what files can ask for before anything is allocated
+    static constexpr uint32_t const MAX_LAYERS = 64;
+    static constexpr uint32_t const MAX_LAYER_SIZE = 1 << 20;
+    static constexpr uint64_t const MAX_LAYER_WEIGHTS = uint64_t(1) << 28;
+
+    struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t dtype;
+        uint32_t layers;
+        uint32_t reserved;
+    };
+
+    struct topology {
+        std::vector<size_t> layer_sizes;
+        // 1-based like the layers
+        std::vector<activation> activations;
+    };
+
+    static bool is_binary(std::istream &is);
+
+    static void write_header(std::ostream &os, topology const &topology);
+    static topology read_header(std::istream &is);
+    // validates the header of a mapped file against its size
+    static topology parse_header(void const *data, size_t size);
+
+    static void write_block(std::ostream &os, float const *values, size_t count);
+    static void read_block(std::istream &is, float *values, size_t count);
+
+    static size_t header_size(size_t layers);
+    static size_t block_size(size_t count);
+    static size_t file_size(topology const &topology);
+
+    static void write_padding(std::ostream &os, size_t size);
+    static void skip_padding(std::istream &is, size_t size);
+
+    // throw unless within the bounds above, at least one layer, for the other
+    // network files too
+    static void check_layers(uint64_t layers);
+    static void check_layer(uint64_t inputs, uint64_t outputs);
+
+private:
+    static void check_header(header const &h);
+    static topology get_topology(header const &h, uint32_t const *values);
+};
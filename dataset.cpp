@@ -0,0 +1,158 @@
+#include "dataset.h"
+#include "mnist_file.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+static size_t align(size_t size) {
+    return (size + dataset::ALIGNMENT - 1) / dataset::ALIGNMENT * dataset::ALIGNMENT;
+}
+
+static size_t labels_offset() {
+    return align(sizeof(dataset::header));
+}
+
+static size_t pixels_offset(size_t images) {
+    return labels_offset() + align(images);
+}
+
+dataset::dataset(std::string const &images_path, std::string const &labels_path)
+    : size_(0)
+    , labels_(nullptr)
+    , pixels_(nullptr)
+    , storage_(nullptr, &std::free)
+{
+    auto const source = get_source_header(images_path, labels_path);
+    auto const cache = cache_path(images_path);
+    if (!map_cache(cache, source)) {
+        parse(images_path, labels_path);
+        try {
+            write_cache(cache, source);
+        } catch (std::exception const &e) {
+            std::cerr << "failed to write dataset cache " << cache << ": " << e.what() << '\n';
+        }
+    }
+    index();
+}
+
+std::string dataset::cache_path(std::string const &images_path) {
+    return images_path + ".cache";
+}
+
+dataset::header dataset::get_source_header(std::string const &images_path, std::string const &labels_path) const {
+    struct stat images_stat, labels_stat;
+    if (stat(images_path.c_str(), &images_stat) < 0)
+        throw std::runtime_error("failed to stat " + images_path);
+    if (stat(labels_path.c_str(), &labels_stat) < 0)
+        throw std::runtime_error("failed to stat " + labels_path);
+
+    header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.image_size = digit_image::IMAGE_SIZE;
+    h.images_file_size = images_stat.st_size;
+    h.labels_file_size = labels_stat.st_size;
+    h.images_file_mtime = images_stat.st_mtime;
+    h.labels_file_mtime = labels_stat.st_mtime;
+    return h;
+}
+
+bool dataset::map_cache(std::string const &path, header const &source) {
+    std::unique_ptr<mapped_file> cache;
+    try {
+        cache = std::make_unique<mapped_file>(path);
+    } catch (std::runtime_error const&) {
+        return false;
+    }
+
+    header h;
+    if (cache->size() < sizeof(h))
+        return false;
+    std::memcpy(&h, cache->data(), sizeof(h));
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0
+        || h.version != source.version
+        || h.image_size != source.image_size
+        || h.images_file_size != source.images_file_size
+        || h.labels_file_size != source.labels_file_size
+        || h.images_file_mtime != source.images_file_mtime
+        || h.labels_file_mtime != source.labels_file_mtime
+        || cache->size() < pixels_offset(h.images) + h.images * digit_image::IMAGE_SIZE)
+    {
+        return false;
+    }
+
+    auto const data = static_cast<uint8_t const*>(cache->data());
+    size_ = h.images;
+    labels_ = data + labels_offset();
+    pixels_ = data + pixels_offset(h.images);
+    cache_ = std::move(cache);
+    return true;
+}
+
+void dataset::parse(std::string const &images_path, std::string const &labels_path) {
+    mnist_file file(images_path, labels_path);
+    size_ = file.image_count();
+
+    auto const size = pixels_offset(size_) + size_ * digit_image::IMAGE_SIZE;
+    storage_.reset(static_cast<uint8_t*>(std::aligned_alloc(ALIGNMENT, align(size))));
+    if (storage_ == nullptr)
+        throw std::bad_alloc();
+
+    auto const labels = storage_.get() + labels_offset();
+    auto const pixels = storage_.get() + pixels_offset(size_);
+    file.read_images(labels, pixels, size_);
+    labels_ = labels;
+    pixels_ = pixels;
+}
+
+void dataset::write_cache(std::string const &path, header const &source) const {
+    auto h = source;
+    h.images = size_;
+
+    auto const temporary = path + ".tmp";
+    std::ofstream cache;
+    cache.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+    cache.open(temporary, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+    static char const zeros[ALIGNMENT] = {};
+    cache.write(reinterpret_cast<char const*>(&h), sizeof(h));
+    cache.write(zeros, labels_offset() - sizeof(h));
+    cache.write(reinterpret_cast<char const*>(labels_), size_);
+    cache.write(zeros, align(size_) - size_);
+    cache.write(reinterpret_cast<char const*>(pixels_), size_ * digit_image::IMAGE_SIZE);
+    cache.close();
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("failed to rename " + temporary);
+}
+
+void dataset::index() {
+    for (auto &indices : indices_)
+        indices.clear();
+    for (size_t i = 0; i < size_; i++) {
+        if (labels_[i] > 9)
+            throw std::runtime_error("invalid label " + std::to_string(labels_[i]));
+        indices_[labels_[i]].push_back(i);
+    }
+}
+
+void dataset::get_pixels(size_t index, Eigen::Ref<Eigen::VectorXf> pixels) const {
+    using pixels_map = Eigen::Map<Eigen::Matrix<uint8_t, digit_image::IMAGE_SIZE, 1> const>;
+    pixels = pixels_map(this->pixels(index)).cast<float>() / 255.0f;
+}
+
+Eigen::MatrixXf dataset::get_pixels(size_t index) const {
+    Eigen::MatrixXf pixels(digit_image::IMAGE_SIZE, 1);
+    get_pixels(index, pixels.col(0));
+    return pixels;
+}
+
+void dataset::get_batch(uint32_t const *indices, size_t count, Eigen::Ref<Eigen::MatrixXf> pixels) const {
+    assert(static_cast<size_t>(pixels.cols()) >= count);
+    for (size_t i = 0; i < count; i++)
+        get_pixels(indices[i], pixels.col(i));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "digit_image.h"
+#include "mapped_file.h"
+
+// All images of an MNIST file pair as one contiguous uint8 array.
+//
+// The first load parses the IDX files and writes a cache next to them; later
+// loads map the cache and use it in place.
+//
+// Cache file, native byte order:
+//   header
+//   padding to ALIGNMENT
+//   uint8_t labels[header.images], padded to ALIGNMENT
+//   uint8_t pixels[header.images * digit_image::IMAGE_SIZE]
+class dataset {
+public:
+    static constexpr char const MAGIC[8] = {'N', 'N', 'N', 'U', 'M', 'D', 'A', 'T'};
+    static constexpr uint32_t const VERSION = 1;
+    static constexpr size_t const ALIGNMENT = 64;
+
+    struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t image_size;
+        uint64_t images;
+        // of the IDX files the cache was built from
+        uint64_t images_file_size;
+        uint64_t labels_file_size;
+        int64_t images_file_mtime;
+        int64_t labels_file_mtime;
+    };
+
+    dataset(std::string const &images_path, std::string const &labels_path);
+
+    dataset(dataset const&) = delete;
+    dataset& operator=(dataset const&) = delete;
+
+    size_t size() const { return size_; }
+    int digit(size_t index) const { return labels_[index]; }
+    uint8_t const* pixels(size_t index) const { return pixels_ + index * digit_image::IMAGE_SIZE; }
+    std::vector<uint32_t> const& indices(int digit) const { return indices_[digit]; }
+
+    // converts an image to floats in [0, 1]
+    void get_pixels(size_t index, Eigen::Ref<Eigen::VectorXf> pixels) const;
+    Eigen::MatrixXf get_pixels(size_t index) const;
+    // converts count images, one per column
+    void get_batch(uint32_t const *indices, size_t count, Eigen::Ref<Eigen::MatrixXf> pixels) const;
+
+    static std::string cache_path(std::string const &images_path);
+
+private:
+    header get_source_header(std::string const &images_path, std::string const &labels_path) const;
+    bool map_cache(std::string const &path, header const &source);
+    void parse(std::string const &images_path, std::string const &labels_path);
+    void write_cache(std::string const &path, header const &source) const;
+    void index();
+
+    size_t size_;
+    uint8_t const *labels_;
+    uint8_t const *pixels_;
+
+    std::unique_ptr<mapped_file> cache_;
+    // when the cache could not be mapped
+    std::unique_ptr<uint8_t, void (*)(void*)> storage_;
+
+    std::vector<uint32_t> indices_[10];
+};
@@ -0,0 +1,128 @@
+#include "ensemble_network.h"
+
+#include <stdexcept>
+
+#include "kernels.h"
+
+ensemble_network::ensemble_network(std::vector<neural_network> const &members, combination combination)
+    : members_(members.size())
+    , combination_(combination)
+{
+    if (members.empty())
+        throw std::invalid_argument("an ensemble needs members");
+    auto const &first = members.front();
+    sizes_ = first.layer_sizes();
+    activations_ = first.activations();
+    for (auto const &member : members)
+        if (member.layer_sizes() != sizes_ || member.activations() != activations_)
+            throw std::invalid_argument("ensemble members differ in topology or activations");
+
+    auto const layers = sizes_.size();
+    // a softmax normalizes every member on its own, which the stacked
+    // product can't, only possible when the first layer is the output one
+    stacked_ = activations_[1] != activation::softmax;
+    if (stacked_)
+        first_weights_.resize(members_ * sizes_[1], sizes_[0]);
+    weights_.resize(layers);
+    biases_.resize(layers);
+    for (size_t layer = 1; layer < layers; layer++) {
+        auto const rows = sizes_[layer];
+        biases_[layer].resize(members_ * rows);
+        for (size_t k = 0; k < members_; k++) {
+            if (layer == 1 && stacked_)
+                first_weights_.middleRows(k * rows, rows) = members[k].weights(layer);
+            else
+                weights_[layer].push_back(members[k].weights(layer));
+            biases_[layer].segment(k * rows, rows) = members[k].biases(layer);
+        }
+    }
+}
+
+void ensemble_network::reserve(workspace &ws, size_t batch_size) const {
+    if (ws.batch_size >= batch_size && ws.as.size() == sizes_.size())
+        return;
+
+    ws.batch_size = batch_size;
+    ws.as.resize(sizes_.size());
+    for (size_t layer = 1; layer < sizes_.size(); layer++)
+        ws.as[layer].resize(members_ * sizes_[layer], batch_size);
+    ws.y.resize(sizes_.back(), batch_size);
+}
+
+Eigen::MatrixXf::ConstColsBlockXpr ensemble_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x,
+                                                                  workspace &ws) const
+{
+    auto const batch_size = x.cols();
+    reserve(ws, batch_size);
+    auto const &kernels = kernels::get();
+
+    for (size_t layer = 1; layer < sizes_.size(); layer++) {
+        auto const rows = sizes_[layer];
+        auto &a = ws.as[layer];
+        if (layer == 1 && stacked_) {
+            kernels.forward(first_weights_.data(), biases_[layer].data(), first_weights_.rows(), first_weights_.cols(),
+                            x.data(), x.outerStride(), a.data(), a.outerStride(), batch_size, activations_[layer]);
+            continue;
+        }
+        // softmax normalizes every member's outputs on its own
+        auto const inputs = sizes_[layer - 1];
+        for (size_t k = 0; k < members_; k++) {
+            // the first layer's members all read the input
+            auto const input = layer == 1 ? x.data() : ws.as[layer - 1].data() + k * inputs;
+            auto const input_stride = layer == 1 ? x.outerStride() : ws.as[layer - 1].outerStride();
+            kernels.forward(weights_[layer][k].data(), biases_[layer].data() + k * rows, rows, inputs,
+                            input, input_stride, a.data() + k * rows, a.outerStride(), batch_size,
+                            activations_[layer]);
+        }
+    }
+
+    combine(member_outputs(ws, batch_size), ws.y.leftCols(batch_size));
+    return static_cast<Eigen::MatrixXf const&>(ws.y).leftCols(batch_size);
+}
+
+void ensemble_network::combine(Eigen::Ref<Eigen::MatrixXf const> const &ys, Eigen::Ref<Eigen::MatrixXf> y) const {
+    auto const outputs = sizes_.back();
+    y.setZero();
+    for (size_t k = 0; k < members_; k++)
+        y += ys.middleRows(k * outputs, outputs);
+    y /= static_cast<float>(members_);
+    if (combination_ == combination::average)
+        return;
+
+    // the average only breaks ties: scaled into [0, 1] per sample, whatever
+    // the output activation's range, then below one vote
+    for (Eigen::Index i = 0; i < ys.cols(); i++) {
+        auto column = y.col(i);
+        float const low = column.minCoeff();
+        float const range = column.maxCoeff() - low;
+        if (range > 0.0f)
+            column = (column.array() - low) / (range * (members_ + 1.0f));
+        else
+            column.setZero();
+        for (size_t k = 0; k < members_; k++) {
+            Eigen::Index digit;
+            ys.col(i).segment(k * outputs, outputs).maxCoeff(&digit);
+            y(digit, i) += 1.0f / members_;
+        }
+    }
+}
+
+Eigen::MatrixXf::ConstColsBlockXpr ensemble_network::member_outputs(workspace const &ws, size_t batch_size) const {
+    return ws.as.back().leftCols(batch_size);
+}
+
+int ensemble_network::get_digit(Eigen::MatrixXf const &x, workspace &ws) const {
+    Eigen::Index digit;
+    feed_forward(x, ws).col(0).maxCoeff(&digit);
+    return digit;
+}
+
+size_t ensemble_network::coefficients_size() const {
+    size_t size = first_weights_.size();
+    for (size_t layer = 1; layer < sizes_.size(); layer++) {
+        for (auto const &weights : weights_[layer])
+            size += weights.size();
+        size += biases_[layer].size();
+    }
+    return size * sizeof(float);
+}
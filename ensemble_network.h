@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "activation.h"
+#include "neural_network.h"
+
+// K networks of one topology evaluated in a single pass.
+//
+// The first layer weights of all members are stacked into one tall matrix,
+// so the input is read once by one matrix product. Later layers hold the
+// activations of all members stacked the same way, member k in rows
+// [k * size, (k + 1) * size), and run one product per member block, the
+// block-diagonal product without its zero blocks. A softmax first layer,
+// the output one, runs per member block too. The member outputs are
+// combined by averaging or by voting.
+class ensemble_network {
+public:
+    enum class combination {
+        // of the member outputs
+        average,
+        // fraction of the members recognizing a digit, ties broken by the average
+        vote,
+    };
+
+    // buffers for up to batch_size samples, 1-based like the layers
+    struct workspace {
+        size_t batch_size = 0;
+        std::vector<Eigen::MatrixXf> as;
+        Eigen::MatrixXf y;
+    };
+
+    ensemble_network(std::vector<neural_network> const &members, combination combination);
+
+    size_t size() const { return members_; }
+    combination get_combination() const { return combination_; }
+    void set_combination(combination combination) { combination_ = combination; }
+
+    void reserve(workspace &ws, size_t batch_size) const;
+
+    // x holds one sample per column, the result lives in ws
+    Eigen::MatrixXf::ConstColsBlockXpr feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const;
+    // member k's outputs in rows [k * 10, (k + 1) * 10), valid after feed_forward
+    Eigen::MatrixXf::ConstColsBlockXpr member_outputs(workspace const &ws, size_t batch_size) const;
+    int get_digit(Eigen::MatrixXf const &x, workspace &ws) const;
+    // y = the combination of member outputs stacked like member_outputs
+    void combine(Eigen::Ref<Eigen::MatrixXf const> const &ys, Eigen::Ref<Eigen::MatrixXf> y) const;
+
+    // bytes of the weights and biases
+    size_t coefficients_size() const;
+
+private:
+    size_t members_;
+    combination combination_;
+    // sizes of one member, 0-based, and its activations, 1-based
+    std::vector<size_t> sizes_;
+    std::vector<activation> activations_;
+
+    // whether the first layer's weights are stacked in first_weights_
+    bool stacked_;
+    Eigen::MatrixXf first_weights_;
+    // per layer, [layer][member] from layer 2 on, and layer 1 unless stacked_
+    std::vector<std::vector<Eigen::MatrixXf>> weights_;
+    // per layer, all members stacked
+    std::vector<Eigen::VectorXf> biases_;
+};
@@ -0,0 +1,105 @@
+#include "evaluator.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iomanip>
+
+evaluation& evaluation::operator+=(evaluation const &other) {
+    images += other.images;
+    correct += other.correct;
+    squared_error += other.squared_error;
+    cross_entropy += other.cross_entropy;
+    for (size_t expected = 0; expected < 10; expected++)
+        for (size_t recognized = 0; recognized < 10; recognized++)
+            confusion[expected][recognized] += other.confusion[expected][recognized];
+    return *this;
+}
+
+float evaluation::loss() const {
+    if (objective == ::loss::cross_entropy)
+        return images ? cross_entropy / images : 0.0f;
+    return rmse();
+}
+
+float evaluation::target_loss() const {
+    return objective == ::loss::cross_entropy ? -std::log(0.8f) : 0.2f;
+}
+
+char const* evaluation::loss_name() const {
+    return objective == ::loss::cross_entropy ? "cross_entropy" : "rmse";
+}
+
+void evaluation::print_confusion(std::ostream &os) const {
+    os << "expected \\ recognized\n  ";
+    for (size_t recognized = 0; recognized < 10; recognized++)
+        os << std::setw(6) << recognized;
+    os << '\n';
+    for (size_t expected = 0; expected < 10; expected++) {
+        os << expected << ' ';
+        for (size_t recognized = 0; recognized < 10; recognized++)
+            os << std::setw(6) << confusion[expected][recognized];
+        os << '\n';
+    }
+}
+
+evaluator::evaluator(dataset const &set)
+    : set_(set)
+    , indices_(set.size())
+{
+    for (size_t i = 0; i < indices_.size(); i++)
+        indices_[i] = i;
+}
+
+evaluator::evaluator(dataset const &set, std::vector<uint32_t> indices)
+    : set_(set)
+    , indices_(std::move(indices))
+{}
+
+evaluation evaluator::evaluate(neural_network const &nn, thread_pool &pool) {
+    workspaces_.resize(pool.size());
+    return evaluate(pool, [&](auto const &pixels, size_t thread) {
+        return nn.feed_forward(pixels, workspaces_[thread]);
+    }, output_loss(nn.activations().back()));
+}
+
+void evaluator::prepare(size_t threads) {
+    pixels_.resize(threads);
+    results_.resize(threads);
+    for (auto &pixels : pixels_)
+        pixels.resize(digit_image::IMAGE_SIZE, BATCH_SIZE);
+}
+
+Eigen::MatrixXf::ColsBlockXpr evaluator::get_batch(size_t first, size_t count, size_t thread) {
+    auto pixels = pixels_[thread].leftCols(count);
+    set_.get_batch(indices_.data() + first, count, pixels);
+    return pixels;
+}
+
+void evaluator::score(size_t first, Eigen::Ref<Eigen::MatrixXf const> const &ys, evaluation &result) const {
+    for (Eigen::Index i = 0; i < ys.cols(); i++) {
+        auto const digit = set_.digit(indices_[first + i]);
+        Eigen::Index recognized;
+        ys.col(i).maxCoeff(&recognized);
+
+        result.images++;
+        if (recognized == digit)
+            result.correct++;
+        result.confusion[digit][recognized]++;
+        // |onehot - y|^2 without materializing the one-hot vector
+        result.squared_error += ys.col(i).squaredNorm() - 2.0f * ys(digit, i) + 1.0f;
+        if (result.objective == loss::cross_entropy)
+            result.cross_entropy -= std::log(std::max(ys(digit, i), FLT_MIN));
+    }
+}
+
+evaluation evaluator::collect(std::chrono::steady_clock::time_point start, loss objective) const {
+    evaluation result;
+    result.objective = objective;
+    for (auto const &r : results_)
+        result += r;
+
+    std::chrono::duration<float> const elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+    return result;
+}
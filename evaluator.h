@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "activation.h"
+#include "dataset.h"
+#include "neural_network.h"
+#include "thread_pool.h"
+
+struct evaluation {
+    size_t images = 0;
+    size_t correct = 0;
+    double squared_error = 0.0;
+    double cross_entropy = 0.0;
+    // the loss the network is trained on
+    ::loss objective = ::loss::squared_error;
+    // confusion[expected][recognized]
+    std::array<std::array<size_t, 10>, 10> confusion{};
+    float seconds = 0.0f;
+
+    float accuracy() const { return images ? static_cast<float>(correct) / images : 0.0f; }
+    float rmse() const { return images ? std::sqrt(squared_error / images) : 0.0f; }
+    // rmse, or the mean cross-entropy of softmax outputs
+    float loss() const;
+    char const* loss_name() const;
+    // training stops below it: an rmse of 0.2, or the cross-entropy of a
+    // correct output of 0.8, which leaves about that rmse
+    float target_loss() const;
+    float images_per_second() const { return seconds > 0.0f ? images / seconds : 0.0f; }
+
+    evaluation& operator+=(evaluation const &other);
+    void print_confusion(std::ostream &os) const;
+};
+
+class evaluator {
+public:
+    static constexpr size_t const BATCH_SIZE = 256;
+
+    // evaluates on the whole set
+    explicit evaluator(dataset const &set);
+    evaluator(dataset const &set, std::vector<uint32_t> indices);
+
+    size_t size() const { return indices_.size(); }
+
+    evaluation evaluate(neural_network const &nn, thread_pool &pool);
+
+    // forward(pixels, thread) returns the outputs for the pixels columns
+    template <typename Forward>
+    evaluation evaluate(thread_pool &pool, Forward const &forward, loss objective = loss::squared_error) {
+        auto const start = std::chrono::steady_clock::now();
+
+        // every thread takes every pool.size()-th batch into its own buffers
+        auto const threads = pool.size();
+        prepare(threads);
+        pool.run(threads, [&](size_t thread) {
+            results_[thread] = evaluation();
+            results_[thread].objective = objective;
+            for (size_t first = thread * BATCH_SIZE; first < size(); first += threads * BATCH_SIZE) {
+                auto const count = std::min(BATCH_SIZE, size() - first);
+                auto const pixels = get_batch(first, count, thread);
+                // one forward pass gives both the recognized digit and the error
+                score(first, forward(pixels, thread), results_[thread]);
+            }
+        });
+
+        return collect(start, objective);
+    }
+
+private:
+    void prepare(size_t threads);
+    Eigen::MatrixXf::ColsBlockXpr get_batch(size_t first, size_t count, size_t thread);
+    void score(size_t first, Eigen::Ref<Eigen::MatrixXf const> const &ys, evaluation &result) const;
+    evaluation collect(std::chrono::steady_clock::time_point start, loss objective) const;
+
+    dataset const &set_;
+    std::vector<uint32_t> indices_;
+
+    // one per thread
+    std::vector<neural_network::workspace> workspaces_;
+    std::vector<Eigen::MatrixXf> pixels_;
+    std::vector<evaluation> results_;
+};
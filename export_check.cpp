@@ -0,0 +1,112 @@
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "activation.h"
+#include "digit_image.h"
+#include "exporter.h"
+#include "neural_network.h"
+
+// make check: exports fixed networks, then builds export_check_driver.cpp
+// against every header with the flags a user might pick. Each build has to
+// pass self_test() and stay within exporter::TOLERANCE of feed_forward.
+//
+//   nnnumber-export-check write DIR      DIR/NAME.h per network, prints the names
+//   nnnumber-export-check verify NAME    reads the driver's output from stdin
+
+struct check_network {
+    char const *name;
+    // of all layers, the input first
+    std::vector<size_t> sizes;
+    // 1-based
+    std::vector<activation> activations;
+};
+
+static std::vector<check_network> const NETWORKS = {
+    {"sigmoid", {digit_image::IMAGE_SIZE, 196, 49, 10},
+     {activation::sigmoid, activation::sigmoid, activation::sigmoid, activation::softmax}},
+    {"relu", {digit_image::IMAGE_SIZE, 64, 10}, {activation::relu, activation::relu, activation::sigmoid}},
+    {"tanh", {digit_image::IMAGE_SIZE, 32, 16, 10}, {activation::tanh, activation::tanh, activation::tanh, activation::softmax}},
+};
+
+static unsigned const SEED = 1;
+static Eigen::Index const PROBES = 10;
+
+// the same network and probes on every call
+static neural_network make_network(check_network const &network, Eigen::MatrixXf &probes) {
+    srand(SEED);
+    neural_network nn(0.1f, network.sizes);
+    for (size_t layer = 1; layer < network.sizes.size(); layer++)
+        nn.set_activation(layer, network.activations[layer]);
+    nn.randomize();
+    probes = (Eigen::MatrixXf::Random(network.sizes.front(), PROBES).array() + 1.0f) / 2.0f;
+    return nn;
+}
+
+static check_network const& find_network(std::string const &name) {
+    for (auto const &network : NETWORKS) {
+        if (network.name == name)
+            return network;
+    }
+    throw std::invalid_argument("unknown network " + name);
+}
+
+static void write(std::string const &directory) {
+    for (auto const &network : NETWORKS) {
+        Eigen::MatrixXf probes;
+        auto const nn = make_network(network, probes);
+        exporter const exporter(nn, probes);
+        std::ofstream output;
+        output.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+        output.open(directory + "/" + network.name + ".h", std::ofstream::out | std::ofstream::trunc);
+        exporter.write(output, "exported", std::string(network.name) + " of export_check.cpp");
+        std::cout << network.name << '\n';
+    }
+}
+
+// the driver prints whether self_test() passed, then the outputs of every
+// probe, one per line
+static bool verify(std::string const &name, std::istream &is) {
+    Eigen::MatrixXf probes;
+    auto const nn = make_network(find_network(name), probes);
+    Eigen::MatrixXf const expected = nn.feed_forward(probes);
+
+    int passed = 0;
+    if (!(is >> passed))
+        throw std::runtime_error("no output of the driver");
+    Eigen::MatrixXf y(expected.rows(), expected.cols());
+    for (Eigen::Index i = 0; i < y.size(); i++) {
+        std::string value;
+        if (!(is >> value))
+            throw std::runtime_error("the driver's output ended early");
+        y.data()[i] = std::strtof(value.c_str(), nullptr);
+    }
+
+    float const difference = (y - expected).cwiseAbs().maxCoeff();
+    bool const close = difference <= exporter::TOLERANCE;
+    std::cout
+        << name << ": self_test " << (passed ? "passed" : "FAILED") << ", largest difference to feed_forward "
+        << difference << (close ? "" : " above the tolerance") << '\n';
+    return passed && close;
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        std::string const command = argc > 1 ? argv[1] : "";
+        if (command == "write" && argc == 3) {
+            write(argv[2]);
+            return 0;
+        }
+        if (command == "verify" && argc == 3)
+            return verify(argv[2], std::cin) ? 0 : 1;
+        std::cerr << "usage: nnnumber-export-check write DIR | verify NAME\n";
+    } catch (std::exception const &e) {
+        std::cerr << "export check: " << e.what() << '\n';
+    }
+    return 1;
+}
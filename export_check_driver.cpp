@@ -0,0 +1,15 @@
+#include <cstddef>
+#include <cstdio>
+
+// Compiled by make check with -include of a header nnnumber-export-check
+// wrote, prints what nnnumber-export-check verify reads.
+int main() {
+    std::printf("%d\n", exported::self_test() ? 1 : 0);
+    for (std::size_t probe = 0; probe < exported::PROBES; probe++) {
+        float y[exported::OUTPUTS];
+        exported::feed_forward(exported::detail::PROBE_INPUTS + probe * exported::INPUTS, y);
+        for (float value : y)
+            std::printf("%a\n", value);
+    }
+    return 0;
+}
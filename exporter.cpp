@@ -0,0 +1,234 @@
+#include "exporter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+// The layer code of every generated header. feed_forward below computes the
+// same operations in the same order, keep the two in step.
+static char const *const RUNTIME = R"(namespace detail {
+    // z = w x + b, w column-major: every input scales one contiguous column,
+    // which vectorizes without reordering the sums. Multiply-adds contracted
+    // into FMAs would round differently, they stay apart whatever the flags.
+    template <std::size_t Outputs, std::size_t Inputs>
+#if defined(__GNUC__) && !defined(__clang__)
+    __attribute__((optimize("fp-contract=off")))
+#endif
+    inline void dense(float const *w, float const *b, float const *x, float *z) {
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+        for (std::size_t o = 0; o < Outputs; o++)
+            z[o] = b[o];
+        for (std::size_t i = 0; i < Inputs; i++) {
+            float const input = x[i];
+            float const *column = w + i * Outputs;
+            for (std::size_t o = 0; o < Outputs; o++)
+                z[o] += column[o] * input;
+        }
+    }
+
+    template <std::size_t Size>
+    inline void sigmoid(float *a) {
+        for (std::size_t i = 0; i < Size; i++)
+            a[i] = 1.0f / (1.0f + std::exp(-a[i]));
+    }
+
+    template <std::size_t Size>
+    inline void tanh(float *a) {
+        for (std::size_t i = 0; i < Size; i++)
+            a[i] = std::tanh(a[i]);
+    }
+
+    template <std::size_t Size>
+    inline void relu(float *a) {
+        for (std::size_t i = 0; i < Size; i++)
+            a[i] = a[i] > 0.0f ? a[i] : 0.0f;
+    }
+
+    template <std::size_t Size>
+    inline void softmax(float *a) {
+        float max = a[0];
+        for (std::size_t i = 1; i < Size; i++)
+            max = a[i] > max ? a[i] : max;
+        float sum = 0.0f;
+        for (std::size_t i = 0; i < Size; i++) {
+            a[i] = std::exp(a[i] - max);
+            sum += a[i];
+        }
+        for (std::size_t i = 0; i < Size; i++)
+            a[i] /= sum;
+    }
+}
+)";
+
+exporter::exporter(neural_network const &nn, Eigen::Ref<Eigen::MatrixXf const> const &probes)
+    : nn_(nn)
+    , probes_(probes)
+{
+    if (probes_.cols() == 0 || probes_.rows() != static_cast<Eigen::Index>(nn_.layer_sizes().front()))
+        throw std::invalid_argument("exporting needs probe inputs of the network's size");
+    for (size_t layer = 1; layer < nn_.layer_sizes().size(); layer++) {
+        if (!nn_.weights(layer).allFinite() || !nn_.biases(layer).allFinite())
+            throw std::runtime_error("can't export coefficients that aren't finite");
+    }
+    expected_ = feed_forward(probes_);
+    difference_ = (expected_ - nn_.feed_forward(probes_)).cwiseAbs().maxCoeff();
+    if (!(difference_ <= TOLERANCE))
+        throw std::runtime_error("generated code differs from feed_forward by " + std::to_string(difference_));
+}
+
+Eigen::MatrixXf exporter::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const {
+    auto const sizes = nn_.layer_sizes();
+    Eigen::MatrixXf y(sizes.back(), x.cols());
+    for (Eigen::Index sample = 0; sample < x.cols(); sample++) {
+        std::vector<float> input(x.col(sample).data(), x.col(sample).data() + sizes.front());
+        for (size_t layer = 1; layer < sizes.size(); layer++) {
+            auto const outputs = sizes[layer], inputs = sizes[layer - 1];
+            auto const w = nn_.weights(layer).data();
+            auto const b = nn_.biases(layer).data();
+            std::vector<float> a(b, b + outputs);
+            for (size_t i = 0; i < inputs; i++) {
+                for (size_t o = 0; o < outputs; o++)
+                    a[o] += w[i * outputs + o] * input[i];
+            }
+            switch (nn_.activations()[layer]) {
+                case activation::sigmoid:
+                    for (auto &value : a)
+                        value = 1.0f / (1.0f + std::exp(-value));
+                    break;
+                case activation::tanh:
+                    for (auto &value : a)
+                        value = std::tanh(value);
+                    break;
+                case activation::relu:
+                    for (auto &value : a)
+                        value = value > 0.0f ? value : 0.0f;
+                    break;
+                case activation::softmax: {
+                    float max = a[0];
+                    for (size_t o = 1; o < outputs; o++)
+                        max = a[o] > max ? a[o] : max;
+                    float sum = 0.0f;
+                    for (auto &value : a) {
+                        value = std::exp(value - max);
+                        sum += value;
+                    }
+                    for (auto &value : a)
+                        value /= sum;
+                    break;
+                }
+            }
+            input.swap(a);
+        }
+        std::copy(input.begin(), input.end(), y.col(sample).data());
+    }
+    return y;
+}
+
+// hexadecimal floats, exact and independent of the locale
+static void write_array(std::ostream &os, std::string const &name, float const *values, size_t count) {
+    os << "    alignas(64) inline constexpr float " << name << '[' << count << "] = {";
+    os << std::hexfloat;
+    for (size_t i = 0; i < count; i++)
+        os << (i % 8 ? " " : "\n        ") << values[i] << "f,";
+    os << std::defaultfloat << "\n    };\n";
+}
+
+void exporter::write(std::ostream &os, std::string const &name, std::string const &source) const {
+    auto const sizes = nn_.layer_sizes();
+    auto const layers = sizes.size();
+    auto const probes = static_cast<size_t>(probes_.cols());
+
+    std::string topology, activations;
+    for (size_t layer = 0; layer < layers; layer++) {
+        topology += (layer ? "-" : "") + std::to_string(sizes[layer]);
+        if (layer > 0)
+            activations += (layer > 1 ? ", " : "") + activation_name(nn_.activations()[layer]);
+    }
+
+    os
+        << "// Generated by nnnumber export from " << source << ", do not edit.\n"
+        << "//\n"
+        << "// A " << topology << " network (" << activations << "), inputs are the\n"
+        << "// pixels in [0, 1] row by row. self_test() compares bit for bit against\n"
+        << "// the exporting host. It holds with any flags short of -ffast-math, which\n"
+        << "// reorders the sums, as long as std::exp and std::tanh round like that\n"
+        << "// host's libm: another libm may miss by an ulp and fail it.\n"
+        << "#pragma once\n"
+        << "\n"
+        << "#include <cmath>\n"
+        << "#include <cstddef>\n"
+        << "\n"
+        << "namespace " << name << " {\n"
+        << "\n"
+        << "inline constexpr std::size_t INPUTS = " << sizes.front() << ";\n"
+        << "inline constexpr std::size_t OUTPUTS = " << sizes.back() << ";\n"
+        << "inline constexpr std::size_t PROBES = " << probes << ";\n"
+        << "\n"
+        << RUNTIME
+        << "\n"
+        << "// weights column-major, outputs x inputs\n"
+        << "namespace detail {\n";
+    for (size_t layer = 1; layer < layers; layer++) {
+        write_array(os, "W" + std::to_string(layer), nn_.weights(layer).data(), nn_.weights(layer).size());
+        write_array(os, "B" + std::to_string(layer), nn_.biases(layer).data(), nn_.biases(layer).size());
+    }
+    os << "\n    // self_test's inputs, one after another, and the outputs they produce\n";
+    write_array(os, "PROBE_INPUTS", probes_.data(), probes_.size());
+    write_array(os, "PROBE_OUTPUTS", expected_.data(), expected_.size());
+    os
+        << "}\n"
+        << "\n"
+        << "// x holds INPUTS values, y receives OUTPUTS\n"
+        << "inline void feed_forward(float const *x, float *y) {\n";
+    for (size_t layer = 1; layer + 1 < layers; layer++)
+        os << "    alignas(64) float a" << layer << '[' << sizes[layer] << "];\n";
+    for (size_t layer = 1; layer < layers; layer++) {
+        auto const input = layer == 1 ? std::string("x") : "a" + std::to_string(layer - 1);
+        auto const output = layer + 1 == layers ? std::string("y") : "a" + std::to_string(layer);
+        os
+            << "    detail::dense<" << sizes[layer] << ", " << sizes[layer - 1] << ">(detail::W" << layer
+            << ", detail::B" << layer << ", " << input << ", " << output << ");\n"
+            << "    detail::" << activation_name(nn_.activations()[layer]) << '<' << sizes[layer] << ">("
+            << output << ");\n";
+    }
+    os
+        << "}\n"
+        << "\n"
+        << "inline int get_digit(float const *x) {\n"
+        << "    float y[OUTPUTS];\n"
+        << "    feed_forward(x, y);\n"
+        << "    std::size_t digit = 0;\n"
+        << "    for (std::size_t i = 1; i < OUTPUTS; i++)\n"
+        << "        digit = y[i] > y[digit] ? i : digit;\n"
+        << "    return static_cast<int>(digit);\n"
+        << "}\n"
+        << "\n"
+        << "// the probes reproduce the exporter's outputs exactly\n"
+        << "inline bool self_test() {\n"
+        << "    for (std::size_t probe = 0; probe < PROBES; probe++) {\n"
+        << "        float y[OUTPUTS];\n"
+        << "        feed_forward(detail::PROBE_INPUTS + probe * INPUTS, y);\n"
+        << "        for (std::size_t i = 0; i < OUTPUTS; i++) {\n"
+        << "            if (y[i] != detail::PROBE_OUTPUTS[probe * OUTPUTS + i])\n"
+        << "                return false;\n"
+        << "        }\n"
+        << "    }\n"
+        << "    return true;\n"
+        << "}\n"
+        << "\n"
+        << "}\n";
+}
+
+std::string exporter::identifier(std::string const &name) {
+    std::string result;
+    for (unsigned char c : name)
+        result += std::isalnum(c) ? static_cast<char>(c) : '_';
+    if (result.empty() || std::isdigit(static_cast<unsigned char>(result.front())))
+        result.insert(result.begin(), '_');
+    return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <Eigen/Eigen>
+
+#include "neural_network.h"
+
+// Writes a neural_network as a self-contained C++17 header: the weights as
+// alignas(64) constexpr arrays, an inference function with fixed dimensions
+// and no dependency beyond <cmath>, nothing to load at startup.
+//
+// Every dense layer scales one contiguous weight column per input, so the
+// compiler vectorizes it without reordering any sum, and the order of the
+// floating-point operations is fixed, FMA contraction included: the
+// generated dense() turns it off, and so does the Makefile for exporter.o.
+// The header embeds probe inputs with the outputs the exporter computed in
+// that same order; its self_test() checks them bit for bit, which also
+// takes a libm whose exp and tanh round like the exporting host's.
+class exporter {
+public:
+    // outputs of the generated code further from feed_forward fail the export
+    static constexpr float const TOLERANCE = 1e-4f;
+
+    // probes holds one input per column
+    exporter(neural_network const &nn, Eigen::Ref<Eigen::MatrixXf const> const &probes);
+
+    // the generated feed_forward's outputs for the probes, one per column
+    Eigen::MatrixXf const& expected() const { return expected_; }
+    // the largest difference between expected() and nn.feed_forward
+    float difference() const { return difference_; }
+
+    // the code goes into namespace name, source is mentioned in a comment
+    void write(std::ostream &os, std::string const &name, std::string const &source) const;
+
+    // a C++ identifier from e.g. a file name
+    static std::string identifier(std::string const &name);
+
+private:
+    Eigen::MatrixXf feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const;
+
+    neural_network const &nn_;
+    Eigen::MatrixXf probes_;
+    Eigen::MatrixXf expected_;
+    float difference_;
+};
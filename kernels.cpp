@@ -0,0 +1,85 @@
+#include "kernels.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace kernels {
+    static table const* table_of(isa isa) {
+        switch (isa) {
+            case isa::sse2: return &sse2_table;
+            case isa::avx2: return &avx2_table;
+            case isa::avx512: return &avx512_table;
+        }
+        throw std::out_of_range("invalid isa");
+    }
+
+    // null until the first use or select()
+    static std::atomic<table const*> current{nullptr};
+    static std::atomic<isa> current_isa{isa::sse2};
+
+    bool supported(isa isa) {
+        // cpuid, including the OS saving the wider registers
+        __builtin_cpu_init();
+        switch (isa) {
+            case isa::sse2:
+                return true;
+            case isa::avx2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            case isa::avx512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                    && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")
+                    && supported(isa::avx2);
+        }
+        return false;
+    }
+
+    isa detect() {
+        for (auto isa : {isa::avx512, isa::avx2})
+            if (supported(isa))
+                return isa;
+        return isa::sse2;
+    }
+
+    void select(isa isa) {
+        if (!supported(isa))
+            throw std::runtime_error("the CPU doesn't support " + isa_name(isa));
+        current_isa = isa;
+        current = table_of(isa);
+    }
+
+    isa selected() {
+        get();
+        return current_isa;
+    }
+
+    table const& get() {
+        auto table = current.load(std::memory_order_acquire);
+        if (table)
+            return *table;
+        // racing first uses pick the same
+        auto const isa = detect();
+        current_isa = isa;
+        table = table_of(isa);
+        current.store(table, std::memory_order_release);
+        return *table;
+    }
+
+    std::string isa_name(isa isa) {
+        switch (isa) {
+            case isa::sse2: return "sse2";
+            case isa::avx2: return "avx2";
+            case isa::avx512: return "avx512";
+        }
+        throw std::out_of_range("invalid isa");
+    }
+
+    isa parse_isa(std::string const &name) {
+        if (name == "sse2")
+            return isa::sse2;
+        if (name == "avx2")
+            return isa::avx2;
+        if (name == "avx512")
+            return isa::avx512;
+        throw std::invalid_argument("invalid isa " + name);
+    }
+}
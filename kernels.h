@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "activation.h"
+#include "optimizer.h"
+
+// The hot dense, activation and update kernels, compiled once per
+// instruction set into the same binary and picked at startup.
+//
+// The kernels of every instruction set live in their own translation unit,
+// built from kernels_impl.h with its own -m flags and its own renamed copy
+// of Eigen, so no inline code of one instruction set can replace another's.
+// That is why the kernels take plain pointers: matrices are column-major,
+// stride floats apart from one column to the next.
+namespace kernels {
+    enum class isa {
+        // the x86-64 baseline
+        sse2,
+        avx2,
+        avx512,
+    };
+
+    struct table {
+        // a = f(w x + b), w is rows x cols, x cols x batch and a rows x batch
+        void (*forward)(float const *w, float const *b, size_t rows, size_t cols,
+                        float const *x, size_t x_stride, float *a, size_t a_stride, size_t batch,
+                        activation f);
+        // a = f(a)
+        void (*activate)(activation f, float *a, size_t rows, size_t cols, size_t stride);
+        // delta *= f'(a)
+        void (*multiply_derivative)(activation f, float const *a, size_t a_stride,
+                                    float *delta, size_t delta_stride, size_t rows, size_t cols);
+        // dw = delta input^T, db = the row sums of delta, previous = w^T delta unless null
+        void (*backward)(float const *w, size_t rows, size_t cols,
+                         float const *delta, size_t delta_stride, float const *input, size_t input_stride,
+                         size_t batch, float *dw, float *db, float *previous, size_t previous_stride);
+        // see ::update_weights
+        void (*update_weights)(optimizer_settings const &settings, float learning_rate, size_t samples,
+                               uint64_t step, float *w, float const *g, float *m, float *v, size_t count);
+        // a = w x + b for a CSR w with rows + 1 offsets, on samples in rows: x is batch x cols and a
+        // batch x rows, so every kept weight scales one contiguous column of x
+        void (*sparse_forward)(int32_t const *offsets, int32_t const *columns, float const *values,
+                               float const *b, size_t rows, float const *x, size_t x_stride,
+                               float *a, size_t a_stride, size_t batch);
+        // the sum of w[i] x[i] over size values, see quantized_network
+        int32_t (*quantized_dot)(int8_t const *w, int16_t const *x, size_t size);
+    };
+
+    // the best instruction set the CPU and the OS support
+    isa detect();
+    bool supported(isa isa);
+    // throws when the CPU doesn't support isa
+    void select(isa isa);
+    isa selected();
+    // the selected kernels, detect()'s until select() is called
+    table const& get();
+
+    std::string isa_name(isa isa);
+    isa parse_isa(std::string const &name);
+
+    // one per instruction set, kernels_<isa>.cpp
+    extern table const sse2_table;
+    extern table const avx2_table;
+    extern table const avx512_table;
+}
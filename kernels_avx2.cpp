@@ -0,0 +1,3 @@
+// the kernels built for avx2, see kernels.h
+#define KERNELS_ISA avx2
+#include "kernels_impl.h"
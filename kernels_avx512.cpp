@@ -0,0 +1,3 @@
+// the kernels built for avx512, see kernels.h
+#define KERNELS_ISA avx512
+#include "kernels_impl.h"
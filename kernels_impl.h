@@ -0,0 +1,198 @@
+// Included once by each kernels_<isa>.cpp, which defines KERNELS_ISA and is
+// compiled with that instruction set. No include guard on purpose.
+//
+// Eigen is renamed per instruction set: its inline functions and template
+// instances get distinct symbols, so the linker can't merge an AVX-512
+// instance into the baseline code paths.
+#define KERNELS_CONCAT(a, b) KERNELS_CONCAT_(a, b)
+#define KERNELS_CONCAT_(a, b) a##b
+#define Eigen KERNELS_CONCAT(Eigen_, KERNELS_ISA)
+
+#include <cmath>
+#include <Eigen/Eigen>
+
+#include "kernels.h"
+
+namespace kernels {
+namespace KERNELS_ISA {
+
+using matrix = Eigen::Map<Eigen::MatrixXf, Eigen::Unaligned, Eigen::OuterStride<>>;
+using const_matrix = Eigen::Map<Eigen::MatrixXf const, Eigen::Unaligned, Eigen::OuterStride<>>;
+using const_weights = Eigen::Map<Eigen::MatrixXf const>;
+
+// per column max-subtraction keeps exp from overflowing
+static void softmax(matrix a) {
+    // per thread, grown to the largest batch
+    thread_local Eigen::RowVectorXf column;
+    auto const columns = a.cols();
+    if (column.size() < columns)
+        column.resize(columns);
+
+    column.head(columns) = a.colwise().maxCoeff();
+    a.rowwise() -= column.head(columns);
+    a.array() = a.array().exp();
+    column.head(columns) = a.colwise().sum();
+    a.array().rowwise() /= column.head(columns).array();
+}
+
+static void activate(activation f, float *data, size_t rows, size_t cols, size_t stride) {
+    matrix a(data, rows, cols, Eigen::OuterStride<>(stride));
+    switch (f) {
+        case activation::sigmoid: a.array() = sigmoid_activation::f(a.array()); break;
+        case activation::tanh: a.array() = tanh_activation::f(a.array()); break;
+        case activation::relu: a.array() = relu_activation::f(a.array()); break;
+        case activation::softmax: softmax(a); break;
+    }
+}
+
+static void multiply_derivative(activation f, float const *a_data, size_t a_stride,
+                                float *delta_data, size_t delta_stride, size_t rows, size_t cols)
+{
+    const_matrix a(a_data, rows, cols, Eigen::OuterStride<>(a_stride));
+    matrix delta(delta_data, rows, cols, Eigen::OuterStride<>(delta_stride));
+    switch (f) {
+        case activation::sigmoid: delta.array() *= sigmoid_activation::derivative(a.array()); break;
+        case activation::tanh: delta.array() *= tanh_activation::derivative(a.array()); break;
+        case activation::relu: delta.array() *= relu_activation::derivative(a.array()); break;
+        // with cross-entropy the error already is the gradient
+        case activation::softmax: break;
+    }
+}
+
+static void forward(float const *w_data, float const *b_data, size_t rows, size_t cols,
+                    float const *x_data, size_t x_stride, float *a_data, size_t a_stride, size_t batch,
+                    activation f)
+{
+    const_weights w(w_data, rows, cols);
+    Eigen::Map<Eigen::VectorXf const> b(b_data, rows);
+    const_matrix x(x_data, cols, batch, Eigen::OuterStride<>(x_stride));
+    matrix a(a_data, rows, batch, Eigen::OuterStride<>(a_stride));
+    a.noalias() = w * x;
+    a.colwise() += b;
+    activate(f, a_data, rows, batch, a_stride);
+}
+
+static void backward(float const *w_data, size_t rows, size_t cols,
+                     float const *delta_data, size_t delta_stride, float const *input_data, size_t input_stride,
+                     size_t batch, float *dw_data, float *db_data, float *previous_data, size_t previous_stride)
+{
+    const_matrix delta(delta_data, rows, batch, Eigen::OuterStride<>(delta_stride));
+    const_matrix input(input_data, cols, batch, Eigen::OuterStride<>(input_stride));
+    Eigen::Map<Eigen::MatrixXf> dw(dw_data, rows, cols);
+    Eigen::Map<Eigen::VectorXf> db(db_data, rows);
+    dw.noalias() = delta * input.transpose();
+    db.noalias() = delta.rowwise().sum();
+    if (previous_data) {
+        matrix previous(previous_data, cols, batch, Eigen::OuterStride<>(previous_stride));
+        previous.noalias() = const_weights(w_data, rows, cols).transpose() * delta;
+    }
+}
+
+// plain loops, vectorized by the compiler for the instruction set
+static void update_weights(optimizer_settings const &settings, float learning_rate, size_t samples, uint64_t step,
+                           float *w, float const *g, float *m, float *v, size_t count)
+{
+    // the gradient averaged over the batch
+    float const scale = 1.0f / samples;
+    float const mu = settings.momentum;
+    float const epsilon = settings.epsilon;
+
+    switch (settings.kind) {
+        case optimizer::sgd: {
+            float const rate = learning_rate * scale;
+            for (size_t i = 0; i < count; i++)
+                w[i] += rate * g[i];
+            break;
+        }
+        case optimizer::momentum:
+            for (size_t i = 0; i < count; i++) {
+                m[i] = mu * m[i] + scale * g[i];
+                w[i] += learning_rate * m[i];
+            }
+            break;
+        case optimizer::nesterov:
+            for (size_t i = 0; i < count; i++) {
+                float const gi = scale * g[i];
+                m[i] = mu * m[i] + gi;
+                w[i] += learning_rate * (gi + mu * m[i]);
+            }
+            break;
+        case optimizer::rmsprop: {
+            float const rho = settings.rmsprop_decay;
+            for (size_t i = 0; i < count; i++) {
+                float const gi = scale * g[i];
+                v[i] = rho * v[i] + (1.0f - rho) * gi * gi;
+                w[i] += learning_rate * gi / (std::sqrt(v[i]) + epsilon);
+            }
+            break;
+        }
+        case optimizer::adam: {
+            float const beta2 = settings.adam_decay;
+            // bias correction folded into the step size
+            float const rate = learning_rate * std::sqrt(1.0f - std::pow(beta2, static_cast<float>(step)))
+                / (1.0f - std::pow(mu, static_cast<float>(step)));
+            for (size_t i = 0; i < count; i++) {
+                float const gi = scale * g[i];
+                m[i] = mu * m[i] + (1.0f - mu) * gi;
+                v[i] = beta2 * v[i] + (1.0f - beta2) * gi * gi;
+                w[i] += rate * m[i] / (std::sqrt(v[i]) + epsilon);
+            }
+            break;
+        }
+    }
+}
+
+static void sparse_forward(int32_t const *offsets, int32_t const *columns, float const *values,
+                           float const *b, size_t rows, float const *x, size_t x_stride,
+                           float *a, size_t a_stride, size_t batch)
+{
+    // samples summed in registers across all kept weights of a row
+    constexpr size_t BLOCK = 16;
+    for (size_t row = 0; row < rows; row++) {
+        auto const begin = offsets[row], end = offsets[row + 1];
+        float *out = a + row * a_stride;
+        size_t i = 0;
+        for (; i + BLOCK <= batch; i += BLOCK) {
+            float sums[BLOCK];
+            for (size_t j = 0; j < BLOCK; j++)
+                sums[j] = b[row];
+            for (auto k = begin; k < end; k++) {
+                float const value = values[k];
+                float const *in = x + columns[k] * x_stride + i;
+                for (size_t j = 0; j < BLOCK; j++)
+                    sums[j] += value * in[j];
+            }
+            for (size_t j = 0; j < BLOCK; j++)
+                out[i + j] = sums[j];
+        }
+        // gathering dot products for the rest, like single samples
+        for (; i < batch; i++) {
+            float sum = b[row];
+            for (auto k = begin; k < end; k++)
+                sum += values[k] * x[columns[k] * x_stride + i];
+            out[i] = sum;
+        }
+    }
+}
+
+// the weights widen to int16 as they load, the products pair up into int32
+static int32_t quantized_dot(int8_t const *w, int16_t const *x, size_t size) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+        sum += w[i] * x[i];
+    return sum;
+}
+
+} // namespace KERNELS_ISA
+
+table const KERNELS_CONCAT(KERNELS_ISA, _table) = {
+    KERNELS_ISA::forward,
+    KERNELS_ISA::activate,
+    KERNELS_ISA::multiply_derivative,
+    KERNELS_ISA::backward,
+    KERNELS_ISA::update_weights,
+    KERNELS_ISA::sparse_forward,
+    KERNELS_ISA::quantized_dot,
+};
+
+} // namespace kernels
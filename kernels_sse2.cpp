@@ -0,0 +1,3 @@
+// the kernels built for sse2, see kernels.h
+#define KERNELS_ISA sse2
+#include "kernels_impl.h"
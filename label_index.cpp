@@ -0,0 +1,119 @@
+#include "label_index.h"
+#include "mnist_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+label_index::label_index(std::string const &labels_path)
+    : header_{}
+    , indices_(nullptr)
+{
+    auto const source = get_source_header(labels_path);
+    auto const path = index_path(labels_path);
+    if (map_index(path, source))
+        return;
+
+    build(labels_path, source);
+    try {
+        write_index(path);
+    } catch (std::exception const &e) {
+        std::cerr << "failed to write label index " << path << ": " << e.what() << '\n';
+    }
+}
+
+std::string label_index::index_path(std::string const &labels_path) {
+    return labels_path + ".index";
+}
+
+label_index::header label_index::get_source_header(std::string const &labels_path) const {
+    struct stat labels_stat;
+    if (stat(labels_path.c_str(), &labels_stat) < 0)
+        throw std::runtime_error("failed to stat " + labels_path);
+
+    header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.labels_file_size = labels_stat.st_size;
+    h.labels_file_mtime = labels_stat.st_mtime;
+    return h;
+}
+
+bool label_index::map_index(std::string const &path, header const &source) {
+    std::unique_ptr<mapped_file> index;
+    try {
+        index = std::make_unique<mapped_file>(path);
+    } catch (std::runtime_error const&) {
+        return false;
+    }
+
+    header h;
+    if (index->size() < sizeof(h))
+        return false;
+    std::memcpy(&h, index->data(), sizeof(h));
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0
+        || h.version != source.version
+        || h.labels_file_size != source.labels_file_size
+        || h.labels_file_mtime != source.labels_file_mtime
+        || h.offsets[0] != 0
+        || h.offsets[10] != h.images
+        || index->size() < sizeof(h) + h.images * sizeof(uint32_t))
+    {
+        return false;
+    }
+    for (int digit = 0; digit < 10; digit++) {
+        if (h.offsets[digit] > h.offsets[digit + 1])
+            return false;
+    }
+
+    header_ = h;
+    indices_ = reinterpret_cast<uint32_t const*>(static_cast<char const*>(index->data()) + sizeof(h));
+    index_ = std::move(index);
+    return true;
+}
+
+void label_index::build(std::string const &labels_path, header const &source) {
+    std::ifstream labels_file;
+    labels_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    labels_file.open(labels_path, std::ifstream::in | std::ifstream::binary);
+    if (mnist_file::read_uint32(labels_file) != mnist_file::HEADER_LABEL_FILE)
+        throw std::runtime_error("invalid labels file format");
+    auto const images = mnist_file::read_uint32(labels_file);
+    std::vector<uint8_t> labels(images);
+    labels_file.read(reinterpret_cast<char*>(labels.data()), labels.size());
+
+    // a counting sort keeps every digit's images in file order
+    header_ = source;
+    header_.images = images;
+    uint32_t counts[10] = {};
+    for (auto label : labels) {
+        if (label > 9)
+            throw std::runtime_error("invalid label " + std::to_string(label));
+        counts[label]++;
+    }
+    for (int digit = 0; digit < 10; digit++)
+        header_.offsets[digit + 1] = header_.offsets[digit] + counts[digit];
+
+    storage_.resize(images);
+    uint32_t next[10];
+    std::memcpy(next, header_.offsets, sizeof(next));
+    for (uint32_t i = 0; i < images; i++)
+        storage_[next[labels[i]]++] = i;
+    indices_ = storage_.data();
+}
+
+void label_index::write_index(std::string const &path) const {
+    auto const temporary = path + ".tmp";
+    std::ofstream index;
+    index.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+    index.open(temporary, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    index.write(reinterpret_cast<char const*>(&header_), sizeof(header_));
+    index.write(reinterpret_cast<char const*>(storage_.data()), storage_.size() * sizeof(uint32_t));
+    index.close();
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("failed to rename " + temporary);
+}
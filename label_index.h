@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// The image indices of every digit of an MNIST labels file.
+//
+// The first open streams the labels and writes the index next to them;
+// later opens map it, so picking an image of a digit reads neither the
+// labels nor the images. Together with mnist_file::read_image a single
+// sample costs one 784-byte read.
+//
+// Index file, native byte order:
+//   header
+//   uint32_t indices[header.images], digit d's in [offsets[d], offsets[d + 1])
+class label_index {
+public:
+    static constexpr char const MAGIC[8] = {'N', 'N', 'N', 'U', 'M', 'I', 'D', 'X'};
+    static constexpr uint32_t const VERSION = 1;
+
+    struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t offsets[11];
+        uint64_t images;
+        // of the labels file the index was built from
+        uint64_t labels_file_size;
+        int64_t labels_file_mtime;
+    };
+
+    explicit label_index(std::string const &labels_path);
+
+    label_index(label_index const&) = delete;
+    label_index& operator=(label_index const&) = delete;
+
+    size_t size() const { return header_.images; }
+    size_t count(int digit) const { return header_.offsets[digit + 1] - header_.offsets[digit]; }
+    // the i-th image of digit
+    uint32_t image(int digit, size_t i) const { return indices_[header_.offsets[digit] + i]; }
+
+    static std::string index_path(std::string const &labels_path);
+
+private:
+    header get_source_header(std::string const &labels_path) const;
+    bool map_index(std::string const &path, header const &source);
+    void build(std::string const &labels_path, header const &source);
+    void write_index(std::string const &path) const;
+
+    header header_;
+    uint32_t const *indices_;
+
+    std::unique_ptr<mapped_file> index_;
+    // when the index could not be mapped
+    std::vector<uint32_t> storage_;
+};
@@ -1,13 +1,208 @@
+#include <sstream>
+
 #include "application.h"
+#include "kernels.h"
+
+// throws on values that don't parse
+static bool parse_option(std::string const &option, std::string const &value, Application::options &options) {
+    if (option == "--batch") {
+        options.batch_size = std::stoul(value);
+        if (options.batch_size == 0)
+            throw std::invalid_argument("empty batch");
+    } else if (option == "--learning-rate") {
+        options.learning_rate = std::stof(value);
+    } else if (option == "--decay") {
+        options.decay = std::stof(value);
+    } else if (option == "--hidden") {
+        options.hidden = parse_layer_sizes(value);
+    } else if (option == "--threads") {
+        options.threads = std::stoul(value);
+    } else if (option == "--parallel") {
+        if (value == "sync") {
+            options.parallel = trainer::mode::synchronous;
+        } else if (value == "hogwild") {
+            options.parallel = trainer::mode::hogwild;
+        } else {
+            std::cerr << "invalid parallel mode " << value << '\n';
+            return false;
+        }
+    } else if (option == "--loaders") {
+        options.loaders = std::stoul(value);
+    } else if (option == "--prefetch") {
+        options.prefetch = std::stoul(value);
+    } else if (option == "--replacement") {
+        if (value == "on") {
+            options.replacement = true;
+        } else if (value == "off") {
+            options.replacement = false;
+        } else {
+            std::cerr << "invalid replacement setting " << value << '\n';
+            return false;
+        }
+    } else if (option == "--augment") {
+        if (value == "on") {
+            options.augment = true;
+        } else if (value == "off") {
+            options.augment = false;
+        } else {
+            std::cerr << "invalid augment setting " << value << '\n';
+            return false;
+        }
+    } else if (option == "--optimizer") {
+        options.optimizer.kind = parse_optimizer(value);
+    } else if (option == "--momentum") {
+        options.optimizer.momentum = std::stof(value);
+    } else if (option == "--target-accuracy") {
+        options.target_accuracy = std::stof(value);
+    } else if (option == "--format") {
+        if (value == "binary") {
+            options.format = Application::coefficients_format::binary;
+        } else if (value == "text") {
+            options.format = Application::coefficients_format::text;
+        } else {
+            std::cerr << "invalid coefficients format " << value << '\n';
+            return false;
+        }
+    } else if (option == "--output") {
+        options.output = value;
+    } else if (option == "--activation") {
+        options.hidden_activation = parse_activation(value);
+    } else if (option == "--output-activation") {
+        options.output_activation = parse_activation(value);
+    } else if (option == "--sparsity") {
+        options.sparsities.clear();
+        std::stringstream list(value);
+        for (std::string level; std::getline(list, level, ',');)
+            options.sparsities.push_back(std::stof(level));
+    } else if (option == "--prune") {
+        options.prune_by = parse_pruning(value);
+    } else if (option == "--fine-tune") {
+        options.fine_tune_epochs = std::stoul(value);
+    } else if (option == "--calibration") {
+        options.calibration_size = std::stoul(value);
+    } else if (option == "--checkpoint-epochs") {
+        options.checkpoint_epochs = std::stoul(value);
+    } else if (option == "--checkpoint-seconds") {
+        options.checkpoint_seconds = std::stof(value);
+    } else if (option == "--keep") {
+        options.keep_checkpoints = std::stoul(value);
+    } else if (option == "--resume") {
+        options.resume = value;
+    } else if (option == "--socket") {
+        options.socket = value;
+    } else if (option == "--max-batch") {
+        options.serving.max_batch = std::stoul(value);
+    } else if (option == "--deadline-us") {
+        options.serving.deadline = std::chrono::microseconds(std::stoul(value));
+    } else if (option == "--combine") {
+        if (value == "average") {
+            options.combination = ensemble_network::combination::average;
+        } else if (value == "vote") {
+            options.combination = ensemble_network::combination::vote;
+        } else {
+            std::cerr << "invalid combination " << value << '\n';
+            return false;
+        }
+    } else if (option == "--workers") {
+        options.serving.workers = std::stoul(value);
+    } else if (option == "--metrics") {
+        options.metrics = value;
+    } else if (option == "--seed") {
+        options.seed = std::stoull(value);
+    } else if (option == "--isa") {
+        if (value != "auto")
+            kernels::parse_isa(value);
+        options.isa = value;
+    } else if (option == "--counters") {
+        if (value == "on") {
+            options.hardware_counters = true;
+        } else if (value == "off") {
+            options.hardware_counters = false;
+        } else {
+            std::cerr << "invalid counters setting " << value << '\n';
+            return false;
+        }
+    } else {
+        std::cerr << "unknown option " << option << '\n';
+        return false;
+    }
+    return true;
+}
+
+static bool parse_options(int argc, char *argv[], Application::options &options) {
+    for (int i = 3; i < argc; i++) {
+        std::string const option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "missing value for " << option << '\n';
+            return false;
+        }
+        std::string const value = argv[++i];
+        try {
+            if (!parse_option(option, value, options))
+                return false;
+        } catch (std::exception const&) {
+            std::cerr << "invalid value for " << option << '\n';
+            return false;
+        }
+    }
+    return true;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
+    Application::options options;
+    if (argc < 3 || !parse_options(argc, argv, options)) {
         auto const program = argc > 0 ? argv[0] : "./nnnumbers";
-        std::cerr << "usage: " << program << " [train/inter/debug] coefficients\n";
+        std::cerr
+            << "usage: " << program << " [train/inter/debug/convert/quantize/serve/ensemble/sweep/prune/export] coefficients [options]\n"
+            << "  ensemble evaluates the members a.bin,b.bin,... fused against one after another\n"
+            << "  sweep trains the configurations of the spec file concurrently, see sweep.h\n"
+            << "  prune reports accuracy and latency by sparsity, writes the last level to --output\n"
+            << "  export writes the network as a C++ header with constexpr weights to --output\n"
+            << "  --batch N              training mini-batch size, at least 1 (default 1, per-sample)\n"
+            << "  --learning-rate R      initial learning rate (default 1.0)\n"
+            << "  --decay D              learning rate / (1 + D * epoch) (default 0.5)\n"
+            << "  --hidden N,N           hidden layer sizes (default 196,49)\n"
+            << "  --threads N            worker threads (default one per hardware thread)\n"
+            << "  --parallel sync        split every batch across the threads, one averaged update (default)\n"
+            << "  --parallel hogwild     every thread trains on its own samples, lock-free updates\n"
+            << "  --loaders N            threads preparing training samples (default 1)\n"
+            << "  --prefetch N           blocks of samples prepared ahead (default 4)\n"
+            << "  --replacement on|off   draw training images with replacement (default off, once per epoch)\n"
+            << "  --augment on|off       distort training images: shifts, rotation, scale, elastic, thickening\n"
+            << "                         (default off), add --loaders when sampling shows up as waiting\n"
+            << "  --optimizer NAME       sgd (default), momentum, nesterov, rmsprop or adam,\n"
+            << "                         the adaptive ones want learning rates around 0.001\n"
+            << "  --momentum M           momentum, adam's first moment decay (default 0.9)\n"
+            << "  --target-accuracy A    train until the test accuracy reaches A, reports the time to it,\n"
+            << "                         otherwise until an rmse of 0.2 or a cross-entropy of 0.22\n"
+            << "  --format binary|text   format of written coefficients (default binary)\n"
+            << "  --output PATH          where convert, quantize, prune and export write the coefficients\n"
+            << "  --activation NAME      hidden layer activation: sigmoid (default), tanh or relu\n"
+            << "  --output-activation NAME\n"
+            << "                         sigmoid on squared error (default) or softmax on cross-entropy\n"
+            << "  --calibration N        training images quantize and activity pruning calibrate on (default 1000)\n"
+            << "  --sparsity S,S         fractions of the hidden layer weights prune drops (default 0.5,0.8,0.9,0.95,0.98)\n"
+            << "  --prune NAME           magnitude (default) or activity, |w| times the mean |input|\n"
+            << "  --fine-tune N          epochs prune trains every pruned network for (default 0)\n"
+            << "  --checkpoint-epochs N  write a checkpoint every N epochs in the background\n"
+            << "  --checkpoint-seconds S write a checkpoint after S seconds since the previous one\n"
+            << "  --keep K               checkpoints kept, coefficients.<epoch>.ckpt (default 3)\n"
+            << "  --resume PATH          continue training from a checkpoint, with its learning rate and decay\n"
+            << "  --socket PATH          serve on a Unix domain socket instead of stdin and stdout\n"
+            << "  --max-batch N          serve requests in batches of up to N (default 32)\n"
+            << "  --deadline-us N        longest wait of a request for its batch to fill (default 1000)\n"
+            << "  --workers N            threads running the served batches (default 1)\n"
+            << "  --combine average|vote how ensemble combines the member outputs (default average)\n"
+            << "  --metrics PATH         write per-epoch timings to PATH, CSV for *.csv, JSON lines otherwise\n"
+            << "  --counters on|off      add perf_event_open hardware counters to the metrics (default off)\n"
+            << "  --isa NAME             kernels for auto (default, the best the CPU supports), sse2, avx2 or avx512\n"
+            << "  --seed N               seed of the initial weights, sampling and augmentation (default from the clock)\n";
         return 1;
     }
 
-    srand(std::chrono::system_clock::now().time_since_epoch().count());
+    if (options.seed == 0)
+        options.seed = std::chrono::system_clock::now().time_since_epoch().count();
+    srand(options.seed);
 
     std::string str_mode = argv[1];
     std::string coefficients_path = argv[2];
@@ -19,12 +214,35 @@ int main(int argc, char *argv[]) {
         mode = Application::mode::interactive;
     } else if (str_mode == "debug") {
         mode = Application::mode::debugging;
+    } else if (str_mode == "convert") {
+        mode = Application::mode::converting;
+    } else if (str_mode == "quantize") {
+        mode = Application::mode::quantizing;
+    } else if (str_mode == "serve") {
+        mode = Application::mode::serving;
+    } else if (str_mode == "ensemble") {
+        mode = Application::mode::ensembling;
+    } else if (str_mode == "sweep") {
+        mode = Application::mode::sweeping;
+    } else if (str_mode == "prune") {
+        mode = Application::mode::pruning;
+    } else if (str_mode == "export") {
+        mode = Application::mode::exporting;
     } else {
         std::cerr << "invalid mode." << std::endl;
         return 1;
     }
 
-    Application app(argc, argv, mode, coefficients_path);
+    if (options.isa != "auto")
+        kernels::select(kernels::parse_isa(options.isa));
+    // stderr, stdout may be serving
+    std::cerr << "using " << kernels::isa_name(kernels::selected()) << " kernels" << std::endl;
+
+    // before the Application starts its threads, for the counters to follow them
+    if (!options.metrics.empty())
+        telemetry::enable(options.metrics, options.hardware_counters);
+
+    Application app(argc, argv, mode, coefficients_path, options);
     app.run();
 
     return 0;
@@ -0,0 +1,37 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(std::string const &path)
+    : data_(nullptr)
+    , size_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("failed to open " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to stat " + path);
+    }
+    size_ = st.st_size;
+
+    if (size_ > 0) {
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data_ == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("failed to map " + path);
+        }
+    }
+    ::close(fd);
+}
+
+mapped_file::~mapped_file() {
+    if (data_ != nullptr)
+        munmap(data_, size_);
+}
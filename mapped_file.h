@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class mapped_file {
+public:
+    explicit mapped_file(std::string const &path);
+    ~mapped_file();
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    void const* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void *data_;
+    size_t size_;
+};
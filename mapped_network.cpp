@@ -0,0 +1,36 @@
+#include "mapped_network.h"
+#include "coefficient_file.h"
+
+mapped_network::mapped_network(std::string const &path)
+    : file_(path)
+    , topology_(coefficient_file::parse_header(file_.data(), file_.size()))
+{
+    auto const &layer_sizes = topology_.layer_sizes;
+    auto const data = static_cast<char const*>(file_.data());
+    auto offset = coefficient_file::header_size(layer_sizes.size());
+    for (size_t layer = 1; layer < layer_sizes.size(); layer++) {
+        auto const rows = layer_sizes[layer];
+        auto const cols = layer_sizes[layer - 1];
+        ws_.emplace_back(reinterpret_cast<float const*>(data + offset), rows, cols);
+        offset += coefficient_file::block_size(rows * cols);
+        bs_.emplace_back(reinterpret_cast<float const*>(data + offset), rows);
+        offset += coefficient_file::block_size(rows);
+    }
+}
+
+Eigen::MatrixXf mapped_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const {
+    Eigen::MatrixXf a = x;
+    for (size_t layer = 0; layer < ws_.size(); layer++) {
+        Eigen::MatrixXf z = (ws_[layer] * a).colwise() + bs_[layer];
+        activate(topology_.activations[layer + 1], z);
+        a = std::move(z);
+    }
+    return a;
+}
+
+int mapped_network::get_digit(Eigen::MatrixXf const &x) const {
+    auto result = feed_forward(x);
+    Eigen::Index max_coeff;
+    result.col(0).maxCoeff(&max_coeff);
+    return max_coeff;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "mapped_file.h"
+#include "coefficient_file.h"
+
+// Inference over a memory-mapped binary coefficients file, the weights are
+// used in place without copying.
+class mapped_network {
+public:
+    explicit mapped_network(std::string const &path);
+
+    // x holds one sample per column
+    Eigen::MatrixXf feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const;
+    int get_digit(Eigen::MatrixXf const &x) const;
+
+    std::vector<size_t> const& layer_sizes() const { return topology_.layer_sizes; }
+    size_t inputs() const { return topology_.layer_sizes.front(); }
+    size_t outputs() const { return topology_.layer_sizes.back(); }
+
+private:
+    using matrix_map = Eigen::Map<Eigen::MatrixXf const, Eigen::Aligned64>;
+    using vector_map = Eigen::Map<Eigen::VectorXf const, Eigen::Aligned64>;
+
+    mapped_file file_;
+    coefficient_file::topology topology_;
+
+    // 0-based, ws_[0] connects the input to the first hidden layer
+    std::vector<matrix_map> ws_;
+    std::vector<vector_map> bs_;
+};
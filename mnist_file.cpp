@@ -1,6 +1,8 @@
 #include "mnist_file.h"
 
-mnist_file::mnist_file(std::string const &images_path, std::string const &labels_path) {
+mnist_file::mnist_file(std::string const &images_path, std::string const &labels_path)
+    : image_count_(0)
+{
     images_file_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     labels_file_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
@@ -48,6 +50,7 @@ void mnist_file::read_headers() {
     auto nbimages = read_uint32(images_file_);
     auto nblabels = read_uint32(labels_file_);
     assert_uint32(nbimages, nblabels);
+    image_count_ = nbimages;
 
     auto nbrows = read_uint32(images_file_);
     auto nbcols = read_uint32(images_file_);
@@ -68,3 +71,15 @@ digit_image mnist_file::next_image() {
     return image;
 }
 
+void mnist_file::read_images(uint8_t *labels, uint8_t *pixels, size_t count) {
+    labels_file_.read(reinterpret_cast<char*>(labels), count);
+    images_file_.read(reinterpret_cast<char*>(pixels), count * digit_image::IMAGE_SIZE);
+}
+
+digit_image mnist_file::read_image(size_t index) {
+    if (index >= image_count_)
+        throw std::out_of_range("image " + std::to_string(index) + " out of " + std::to_string(image_count_));
+    labels_file_.seekg(LABELS_HEADER_SIZE + index);
+    images_file_.seekg(IMAGES_HEADER_SIZE + index * digit_image::IMAGE_SIZE);
+    return next_image();
+}
@@ -14,17 +14,27 @@ public:
     ~mnist_file();
 
     void close();
-    uint32_t read_uint32(std::istream &is);
+    static uint32_t read_uint32(std::istream &is);
     void assert_uint32(uint32_t test, uint32_t required);
     void read_headers();
     bool has_next_image();
     digit_image next_image();
+    // reads count raw labels and count * digit_image::IMAGE_SIZE raw pixels
+    void read_images(uint8_t *labels, uint8_t *pixels, size_t count);
+    // seeks to and reads only the image at index, moves the next_image position
+    digit_image read_image(size_t index);
+
+    size_t image_count() const { return image_count_; }
 
     static constexpr uint32_t const HEADER_LABEL_FILE = 0x801;
     static constexpr uint32_t const HEADER_TRAINING_FILE = 0x803;
+    // bytes before the first label and the first image
+    static constexpr size_t const LABELS_HEADER_SIZE = 8;
+    static constexpr size_t const IMAGES_HEADER_SIZE = 16;
 
 private:
     std::ifstream images_file_;
     std::ifstream labels_file_;
+    size_t image_count_;
 };
 
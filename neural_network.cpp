@@ -1,8 +1,14 @@
 #include "neural_network.h"
+#include "coefficient_file.h"
+#include "telemetry.h"
+#include "kernels.h"
 
 #include <stdexcept>
 #include <cstdarg>
 #include <cassert>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 static Eigen::MatrixXf generate_right_answer(char number) {
     Eigen::MatrixXf y(10, 1);
@@ -49,54 +55,84 @@ void neural_network::read_vector(Eigen::VectorXf &vector, std::istream &is) {
     vector = Eigen::Map<Eigen::VectorXf>(values.data(), vector.size());
 }
 
-float neural_network::sigmoid(float x) {
-    return 1.0f / (1.0f + exp(-x));
-}
-
-float neural_network::sigmoid_derivative(float x) {
-    return sigmoid(x) * (1.0f - sigmoid(x));
-}
-
-float neural_network::tanh(float x) {
-    return std::tanh(x);
-}
-
-float neural_network::tanh_derivative(float x) {
-    return 1.0f - std::tanh(x) * std::tanh(x);
-}
-
 neural_network::neural_network(float learning_rate, int layers, ...)
     : learning_rate_(learning_rate)
     , layers_(layers)
 {
-    if (layers < 2)
+    std::vector<size_t> sizes(std::max(layers, 0));
+    va_list arguments;
+    va_start(arguments, layers);
+    for (auto &size : sizes)
+        size = va_arg(arguments, size_t);
+    va_end(arguments);
+    initialize(sizes);
+}
+
+neural_network::neural_network(float learning_rate, std::vector<size_t> const &sizes)
+    : learning_rate_(learning_rate)
+    , layers_(sizes.size())
+{
+    initialize(sizes);
+}
+
+void neural_network::initialize(std::vector<size_t> const &sizes) {
+    if (layers_ < 2)
         throw std::out_of_range("minimum layer count is 2");
 
     ws_.resize(layers_);
     bs_.resize(layers_);
+    activations_.resize(layers_, activation::sigmoid);
+    masks_.resize(layers_);
 
-    va_list sizes;
-    va_start(sizes, layers);
-    size_t input_layer_size = va_arg(sizes, size_t);
     // 1-based indices
     for (int i = 1; i < layers_; i++) {
-        size_t output_layer_size = va_arg(sizes, size_t);
-        ws_[i] = Eigen::MatrixXf::Random(output_layer_size, input_layer_size);
-        bs_[i] = Eigen::VectorXf::Random(output_layer_size);
-        input_layer_size = output_layer_size;
+        ws_[i] = Eigen::MatrixXf::Random(sizes[i], sizes[i - 1]);
+        bs_[i] = Eigen::VectorXf::Random(sizes[i]);
     }
-    va_end(sizes);
+}
+
+std::vector<size_t> parse_layer_sizes(std::string const &list) {
+    std::vector<size_t> sizes;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        auto end = list.find(',', begin);
+        if (end == std::string::npos)
+            end = list.size();
+        auto const size = std::stoul(list.substr(begin, end - begin));
+        if (size == 0)
+            throw std::invalid_argument("empty layer in " + list);
+        sizes.push_back(size);
+        begin = end + 1;
+    }
+    return sizes;
 }
 
 void neural_network::read_coefficients(std::istream &is) {
-    for (auto &w : ws_)
-        read_matrix(w, is);
+    if (!coefficient_file::is_binary(is)) {
+        for (auto &w : ws_)
+            read_matrix(w, is);
 
-    for (auto &b : bs_)
-        read_vector(b, is);
+        for (auto &b : bs_)
+            read_vector(b, is);
+        return;
+    }
+
+    auto const topology = coefficient_file::read_header(is);
+    if (topology.layer_sizes != layer_sizes())
+        throw std::runtime_error("coefficients topology does not match the network");
+    activations_ = topology.activations;
+    for (int layer = 1; layer < layers_; layer++) {
+        coefficient_file::read_block(is, ws_[layer].data(), ws_[layer].size());
+        coefficient_file::read_block(is, bs_[layer].data(), bs_[layer].size());
+    }
 }
 
 void neural_network::save_coefficients(std::ostream &os) {
+    for (int layer = 1; layer < layers_; layer++) {
+        if (activations_[layer] != activation::sigmoid)
+            throw std::runtime_error("the text coefficients format only holds sigmoid layers");
+    }
+
     for (auto &w : ws_)
         os << w << '\n';
 
@@ -104,52 +140,267 @@ void neural_network::save_coefficients(std::ostream &os) {
         os << b << '\n';
 }
 
-Eigen::MatrixXf neural_network::feed_forward(Eigen::MatrixXf const &x) {
-    auto a = x;
+void neural_network::save_binary_coefficients(std::ostream &os) const {
+    coefficient_file::write_header(os, {layer_sizes(), activations_});
+    for (int layer = 1; layer < layers_; layer++) {
+        coefficient_file::write_block(os, ws_[layer].data(), ws_[layer].size());
+        coefficient_file::write_block(os, bs_[layer].data(), bs_[layer].size());
+    }
+}
+
+void neural_network::set_activation(int layer, activation activation) {
+    if (layer < 1 || layer >= layers_)
+        throw std::out_of_range("invalid layer");
+    if (activation == activation::softmax && layer != layers_ - 1)
+        throw std::invalid_argument("softmax is only supported on the output layer");
+    activations_[layer] = activation;
+}
+
+void neural_network::set_mask(int layer, Eigen::MatrixXf const &mask) {
+    if (layer < 1 || layer >= layers_)
+        throw std::out_of_range("invalid layer");
+    if (mask.size() != 0 && (mask.rows() != ws_[layer].rows() || mask.cols() != ws_[layer].cols()))
+        throw std::invalid_argument("mask size does not match the layer");
+    masks_[layer] = mask;
+    if (mask.size() != 0)
+        ws_[layer].array() *= mask.array();
+}
+
+void neural_network::copy_coefficients(neural_network const &other) {
+    if (other.layer_sizes() != layer_sizes())
+        throw std::runtime_error("coefficients topology does not match the network");
     for (int layer = 1; layer < layers_; layer++) {
-        auto z = ws_[layer] * a + bs_[layer];
-        a = z.unaryExpr(&sigmoid);
+        ws_[layer] = other.ws_[layer];
+        bs_[layer] = other.bs_[layer];
     }
-    return a;
+    activations_ = other.activations_;
+    masks_ = other.masks_;
+    optimizer_ = other.optimizer_;
+    steps_ = other.steps_;
+    ws_m_ = other.ws_m_;
+    ws_v_ = other.ws_v_;
+    bs_m_ = other.bs_m_;
+    bs_v_ = other.bs_v_;
 }
 
-int neural_network::get_digit(Eigen::MatrixXf const &x) {
+void neural_network::randomize() {
+    for (int layer = 1; layer < layers_; layer++) {
+        float const inputs = ws_[layer].cols();
+        float const outputs = ws_[layer].rows();
+        float scale = 1.0f;
+        switch (activations_[layer]) {
+            case activation::sigmoid: scale = 1.0f; break;
+            case activation::tanh: scale = std::sqrt(6.0f / (inputs + outputs)); break;
+            case activation::relu: scale = std::sqrt(6.0f / inputs); break;
+            case activation::softmax: scale = std::sqrt(6.0f / (inputs + outputs)); break;
+        }
+        ws_[layer].setRandom();
+        ws_[layer] *= scale;
+        bs_[layer].setRandom();
+        bs_[layer] *= scale;
+    }
+}
+
+std::vector<size_t> neural_network::layer_sizes() const {
+    std::vector<size_t> sizes(layers_);
+    sizes[0] = ws_[1].cols();
+    for (int layer = 1; layer < layers_; layer++)
+        sizes[layer] = ws_[layer].rows();
+    return sizes;
+}
+
+void neural_network::reserve(workspace &ws, size_t batch_size) const {
+    if (ws.batch_size >= batch_size && ws.as.size() == static_cast<size_t>(layers_))
+        return;
+
+    ws.batch_size = batch_size;
+    ws.as.resize(layers_);
+    ws.errors.resize(layers_);
+    ws.g.dws.resize(layers_);
+    ws.g.dbs.resize(layers_);
+    for (int layer = 1; layer < layers_; layer++) {
+        ws.as[layer].resize(ws_[layer].rows(), batch_size);
+        ws.errors[layer].resize(ws_[layer].rows(), batch_size);
+        ws.g.dws[layer].resize(ws_[layer].rows(), ws_[layer].cols());
+        ws.g.dbs[layer].resize(ws_[layer].rows());
+    }
+}
+
+Eigen::MatrixXf neural_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const {
+    workspace ws;
+    return feed_forward(x, ws);
+}
+
+Eigen::MatrixXf::ConstColsBlockXpr neural_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const {
+    auto const batch_size = x.cols();
+    reserve(ws, batch_size);
+
+    for (int layer = 1; layer < layers_; layer++)
+        feed_forward_layer(layer, x, ws);
+    return static_cast<Eigen::MatrixXf const&>(ws.as.back()).leftCols(batch_size);
+}
+
+void neural_network::feed_forward_layer(int layer, Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const {
+    auto const &w = ws_[layer];
+    auto &a = ws.as[layer];
+    auto const input = layer == 1 ? nullptr : &ws.as[layer - 1];
+    kernels::get().forward(w.data(), bs_[layer].data(), w.rows(), w.cols(),
+                           input ? input->data() : x.data(), input ? input->outerStride() : x.outerStride(),
+                           a.data(), a.outerStride(), x.cols(), activations_[layer]);
+}
+
+int neural_network::get_digit(Eigen::MatrixXf const &x) const {
     auto result = feed_forward(x);
     Eigen::Index max_coeff;
     result.col(0).maxCoeff(&max_coeff);
     return max_coeff;
 }
 
-Eigen::MatrixXf neural_network::get_error(int digit, Eigen::MatrixXf const &x) {
-    auto y = feed_forward(x);
-    return Ys[digit] - y;
+float neural_network::get_error(int digit, Eigen::MatrixXf const &x) const {
+    auto const y = feed_forward(x);
+    if (output_loss(activations_.back()) == loss::cross_entropy)
+        return -std::log(std::max(y(digit, 0), FLT_MIN));
+    return y.col(0).squaredNorm() - 2.0f * y(digit, 0) + 1.0f;
 }
 
 void neural_network::train(int digit, Eigen::MatrixXf const &x) {
-    std::vector<Eigen::MatrixXf> zs(layers_);
-    std::vector<Eigen::MatrixXf> as(layers_);
+    Eigen::Matrix<int, 1, 1> const digits(digit);
+    train_batch(digits, x);
+}
+
+void neural_network::train_batch(Eigen::Ref<Eigen::VectorXi const> const &digits, Eigen::Ref<Eigen::MatrixXf const> const &x) {
+    compute_gradient(digits, x, workspace_);
+    // one update per batch, averaged over its samples
+    apply_gradient(workspace_.g, x.cols(), begin_step());
+}
 
-    as[0] = x;
+void neural_network::compute_gradient(Eigen::Ref<Eigen::VectorXi const> const &digits,
+                                      Eigen::Ref<Eigen::MatrixXf const> const &x,
+                                      workspace &ws) const
+{
+    assert(digits.size() == x.cols());
+    auto const batch_size = x.cols();
+
+    reserve(ws, batch_size);
     for (int layer = 1; layer < layers_; layer++) {
-        zs[layer] = ws_[layer] * as[layer - 1] + bs_[layer];
-        as[layer] = zs[layer].unaryExpr(&sigmoid);
+        telemetry::scoped_timer timer(telemetry::phase::forward, layer);
+        feed_forward_layer(layer, x, ws);
     }
+    auto const y = ws.as.back().leftCols(batch_size);
 
-    std::vector<Eigen::MatrixXf> dws(layers_);
-    std::vector<Eigen::MatrixXf> dbs(layers_);
+    auto &g = ws.g;
+    auto const &table = kernels::get();
+    // onehot - y straight from the labels, for softmax the fused
+    // cross-entropy gradient as its derivative is skipped below
+    auto output_error = ws.errors.back().leftCols(batch_size);
+    output_error = -y;
+    for (Eigen::Index i = 0; i < batch_size; i++)
+        output_error(digits(i), i) += 1.0f;
 
-    Eigen::MatrixXf error = Ys[digit] - as.back();
     for (int layer = layers_ - 1; layer > 0; layer--) {
-        auto delta = error.cwiseProduct(zs[layer].unaryExpr(&sigmoid_derivative));
-        dws[layer] = learning_rate_ * delta * as[layer - 1].transpose();
-        dbs[layer] = learning_rate_ * delta * 1.0f;
-        if (layer > 1) // don't calculate when exiting the loop
-            error = ws_[layer].transpose() * delta;
+        telemetry::scoped_timer timer(telemetry::phase::backward, layer);
+        auto &delta = ws.errors[layer];
+        auto const &w = ws_[layer];
+        table.multiply_derivative(activations_[layer], ws.as[layer].data(), ws.as[layer].outerStride(),
+                                  delta.data(), delta.outerStride(), delta.rows(), batch_size);
+        auto const input = layer == 1 ? nullptr : &ws.as[layer - 1];
+        // the error of the previous layer, not needed for the input
+        auto previous = layer > 1 ? &ws.errors[layer - 1] : nullptr;
+        table.backward(w.data(), w.rows(), w.cols(), delta.data(), delta.outerStride(),
+                       input ? input->data() : x.data(), input ? input->outerStride() : x.outerStride(), batch_size,
+                       g.dws[layer].data(), g.dbs[layer].data(),
+                       previous ? previous->data() : nullptr, previous ? previous->outerStride() : 0);
     }
+}
+
+static std::pair<Eigen::Index, Eigen::Index> get_share(Eigen::Index size, size_t part, size_t parts) {
+    auto const begin = size * part / parts;
+    auto const end = size * (part + 1) / parts;
+    return {begin, end - begin};
+}
 
+void neural_network::gradient::add(gradient const &other, size_t part, size_t parts) {
+    telemetry::scoped_timer timer(telemetry::phase::update);
+    for (size_t layer = 1; layer < dws.size(); layer++) {
+        auto const [begin, count] = get_share(dws[layer].cols(), part, parts);
+        dws[layer].middleCols(begin, count) += other.dws[layer].middleCols(begin, count);
+        if (part == 0)
+            dbs[layer] += other.dbs[layer];
+    }
+}
+
+void neural_network::apply_gradient(gradient const &g, size_t samples, uint64_t step, size_t part, size_t parts) {
+    telemetry::scoped_timer timer(telemetry::phase::update);
+    bool const first = uses_first_moment(optimizer_.kind);
+    bool const second = uses_second_moment(optimizer_.kind);
     for (int layer = 1; layer < layers_; layer++) {
-        ws_[layer] += dws[layer];
-        bs_[layer] += dbs[layer];
+        // a share of columns is contiguous in the column-major matrices
+        auto const rows = ws_[layer].rows();
+        auto const [begin, count] = get_share(ws_[layer].cols(), part, parts);
+        auto const offset = begin * rows;
+        update_weights(optimizer_, learning_rate_, samples, step,
+                       ws_[layer].data() + offset, g.dws[layer].data() + offset,
+                       first ? ws_m_[layer].data() + offset : nullptr,
+                       second ? ws_v_[layer].data() + offset : nullptr,
+                       count * rows);
+        // pruned weights stay zero whatever the optimizer's moments say
+        if (masks_[layer].size() != 0)
+            ws_[layer].middleCols(begin, count).array() *= masks_[layer].middleCols(begin, count).array();
+        if (part == 0) {
+            update_weights(optimizer_, learning_rate_, samples, step,
+                           bs_[layer].data(), g.dbs[layer].data(),
+                           first ? bs_m_[layer].data() : nullptr,
+                           second ? bs_v_[layer].data() : nullptr,
+                           bs_[layer].size());
+        }
+    }
+}
+
+void neural_network::set_optimizer(optimizer_settings const &settings) {
+    optimizer_ = settings;
+    steps_.value = 0;
+    auto const reset = [this](bool used, std::vector<Eigen::MatrixXf> &ws, std::vector<Eigen::VectorXf> &bs) {
+        ws.clear();
+        bs.clear();
+        if (!used)
+            return;
+        ws.resize(layers_);
+        bs.resize(layers_);
+        for (int layer = 1; layer < layers_; layer++) {
+            ws[layer] = Eigen::MatrixXf::Zero(ws_[layer].rows(), ws_[layer].cols());
+            bs[layer] = Eigen::VectorXf::Zero(bs_[layer].size());
+        }
+    };
+    reset(uses_first_moment(settings.kind), ws_m_, bs_m_);
+    reset(uses_second_moment(settings.kind), ws_v_, bs_v_);
+}
+
+void neural_network::save_optimizer_state(std::ostream &os) const {
+    uint64_t const steps = steps_.value;
+    os.write(reinterpret_cast<char const*>(&steps), sizeof(steps));
+    coefficient_file::write_padding(os, coefficient_file::ALIGNMENT - sizeof(steps));
+    for (auto const *moments : {&ws_m_, &ws_v_}) {
+        for (size_t layer = 1; layer < moments->size(); layer++)
+            coefficient_file::write_block(os, (*moments)[layer].data(), (*moments)[layer].size());
+    }
+    for (auto const *moments : {&bs_m_, &bs_v_}) {
+        for (size_t layer = 1; layer < moments->size(); layer++)
+            coefficient_file::write_block(os, (*moments)[layer].data(), (*moments)[layer].size());
+    }
+}
+
+void neural_network::read_optimizer_state(std::istream &is) {
+    uint64_t steps;
+    is.read(reinterpret_cast<char*>(&steps), sizeof(steps));
+    coefficient_file::skip_padding(is, coefficient_file::ALIGNMENT - sizeof(steps));
+    steps_.value = steps;
+    for (auto *moments : {&ws_m_, &ws_v_}) {
+        for (size_t layer = 1; layer < moments->size(); layer++)
+            coefficient_file::read_block(is, (*moments)[layer].data(), (*moments)[layer].size());
+    }
+    for (auto *moments : {&bs_m_, &bs_v_}) {
+        for (size_t layer = 1; layer < moments->size(); layer++)
+            coefficient_file::read_block(is, (*moments)[layer].data(), (*moments)[layer].size());
     }
 }
 
@@ -1,21 +1,95 @@
 #pragma once
 
 #include <Eigen/Eigen>
+#include <atomic>
+#include <string>
 #include <vector>
 
 #include "digit_image.h"
+#include "activation.h"
+#include "optimizer.h"
 
 class neural_network {
 public:
+    // Sums of the per-sample weight and bias steps over a batch, 1-based
+    // indexed like the network layers.
+    struct gradient {
+        std::vector<Eigen::MatrixXf> dws;
+        std::vector<Eigen::VectorXf> dbs;
+
+        // adds the columns [part] of [parts] of other
+        void add(gradient const &other, size_t part = 0, size_t parts = 1);
+    };
+
+    // Buffers of the forward and the backward pass for up to batch_size
+    // samples, sized from the topology by reserve(), 1-based indexed like the
+    // network layers. Training and inference through a reserved workspace
+    // don't allocate.
+    struct workspace {
+        size_t batch_size = 0;
+        std::vector<Eigen::MatrixXf> as;
+        // error of the layer outputs, turned into deltas in place
+        std::vector<Eigen::MatrixXf> errors;
+        gradient g;
+    };
+
     neural_network(float learning_rate, int layers, ...);
+    // sizes of all layers, the input first
+    neural_network(float learning_rate, std::vector<size_t> const &sizes);
 
+    // detects the text and the binary formats
     void read_coefficients(std::istream &is);
     void save_coefficients(std::ostream &os);
+    void save_binary_coefficients(std::ostream &os) const;
+
+    std::vector<size_t> layer_sizes() const;
+    // 1-based, sigmoid by default
+    std::vector<activation> const& activations() const { return activations_; }
+    // 1-based
+    Eigen::MatrixXf const& weights(int layer) const { return ws_[layer]; }
+    Eigen::VectorXf const& biases(int layer) const { return bs_[layer]; }
+    void set_activation(int layer, activation activation);
+    // 1-based, 1 for kept and 0 for pruned weights, empty for a dense layer
+    Eigen::MatrixXf const& mask(int layer) const { return masks_[layer]; }
+    // zeroes the pruned weights and keeps them zero through training, an
+    // empty mask makes the layer dense again
+    void set_mask(int layer, Eigen::MatrixXf const &mask);
+    // weights, biases, activations and the optimizer with its state of a
+    // network of the same topology, without allocating once warm
+    void copy_coefficients(neural_network const &other);
 
-    Eigen::MatrixXf feed_forward(Eigen::MatrixXf const &x);
-    int get_digit(Eigen::MatrixXf const &x);
-    Eigen::MatrixXf get_error(int digit, Eigen::MatrixXf const &x);
+    optimizer_settings const& get_optimizer() const { return optimizer_; }
+    // starts with zeroed moments
+    void set_optimizer(optimizer_settings const &settings);
+    // the update count and the moment buffers
+    void save_optimizer_state(std::ostream &os) const;
+    void read_optimizer_state(std::istream &is);
+    // Draws new random weights. Sigmoid layers keep the original [-1, 1]
+    // range, tanh layers use Glorot and relu layers He scaling.
+    void randomize();
+
+    void reserve(workspace &ws, size_t batch_size) const;
+
+    // x holds one sample per column
+    Eigen::MatrixXf feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const;
+    // the result lives in ws
+    Eigen::MatrixXf::ConstColsBlockXpr feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const;
+    int get_digit(Eigen::MatrixXf const &x) const;
+    // squared error, or cross-entropy for a softmax output, of one sample
+    float get_error(int digit, Eigen::MatrixXf const &x) const;
     void train(int digit, Eigen::MatrixXf const &x);
+    // x holds one sample per column, digits holds the matching labels
+    void train_batch(Eigen::Ref<Eigen::VectorXi const> const &digits, Eigen::Ref<Eigen::MatrixXf const> const &x);
+    // leaves the gradient in ws.g
+    void compute_gradient(Eigen::Ref<Eigen::VectorXi const> const &digits,
+                          Eigen::Ref<Eigen::MatrixXf const> const &x,
+                          workspace &ws) const;
+    // Counts one update and returns its number for apply_gradient. Parts of
+    // one update share the number.
+    uint64_t begin_step() { return ++steps_.value; }
+    // One optimizer step with g summed over samples, restricted to the
+    // columns [part] of [parts].
+    void apply_gradient(gradient const &g, size_t samples, uint64_t step, size_t part = 0, size_t parts = 1);
 
     float get_learning_rate() const;
     void set_learning_rate(float rate);
@@ -23,19 +97,41 @@ public:
     static void read_matrix(Eigen::MatrixXf &matrix, std::istream &is);
     static void read_vector(Eigen::VectorXf &vector, std::istream &is);
 
-    static float sigmoid(float x);
-    static float sigmoid_derivative(float x);
-    static float tanh(float x);
-    static float tanh_derivative(float x);
-
     static Eigen::MatrixXf Ys[10];
 
 private:
+    void initialize(std::vector<size_t> const &sizes);
+    // computes ws.as[layer] from the previous layer or x
+    void feed_forward_layer(int layer, Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const;
+
     float learning_rate_;
     int layers_;
 
     // 1-based indexed vector
     std::vector<Eigen::MatrixXf> ws_;
     std::vector<Eigen::VectorXf> bs_;
+    std::vector<activation> activations_;
+    std::vector<Eigen::MatrixXf> masks_;
+
+    // copyable, hogwild threads count concurrently
+    struct step_counter {
+        std::atomic<uint64_t> value{0};
+
+        step_counter() = default;
+        step_counter(step_counter const &other) : value(other.value.load()) {}
+        step_counter& operator=(step_counter const &other) { value = other.value.load(); return *this; }
+    };
+
+    optimizer_settings optimizer_;
+    step_counter steps_;
+    // first and second moments, 1-based, empty when unused
+    std::vector<Eigen::MatrixXf> ws_m_, ws_v_;
+    std::vector<Eigen::VectorXf> bs_m_, bs_v_;
+
+    // used by train and train_batch
+    workspace workspace_;
 };
 
+// "196,49" into {196, 49}
+std::vector<size_t> parse_layer_sizes(std::string const &list);
+
@@ -0,0 +1,103 @@
+#include "online_trainer.h"
+
+#include <algorithm>
+#include <cerrno>
+
+online_trainer::online_trainer(neural_network const &nn, dataset const *replay, options const &options)
+    : options_(options)
+    , replay_(replay && replay->size() > 0 ? replay : nullptr)
+    , training_(nn)
+    , random_engine_(options.seed)
+    , digits_(std::max<size_t>(options.batch_size, 1))
+    , x_(digit_image::IMAGE_SIZE, std::max<size_t>(options.batch_size, 1))
+    , replay_indices_(std::max<size_t>(options.batch_size, 1) - 1)
+    , head_(0)
+    , tail_(0)
+    , published_(0)
+    , readers_{}
+    , version_(0)
+    , stopping_(false)
+{
+    training_.set_learning_rate(options_.learning_rate);
+    for (auto &buffer : buffers_)
+        buffer = std::make_unique<neural_network>(nn);
+    sem_init(&queued_, 0, 0);
+    trainer_ = std::thread(&online_trainer::run, this);
+}
+
+online_trainer::~online_trainer() {
+    stopping_ = true;
+    sem_post(&queued_);
+    trainer_.join();
+    sem_destroy(&queued_);
+}
+
+bool online_trainer::correct(int digit, Eigen::Ref<Eigen::MatrixXf const> const &pixels) {
+    auto const tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == QUEUE_SIZE)
+        return false;
+
+    // the trainer doesn't read the slot before tail_ moves past it
+    auto &correction = queue_[tail % QUEUE_SIZE];
+    correction.digit = digit;
+    std::copy_n(pixels.data(), correction.pixels.size(), correction.pixels.begin());
+    tail_.store(tail + 1, std::memory_order_release);
+    sem_post(&queued_);
+    return true;
+}
+
+int online_trainer::pin() const {
+    while (true) {
+        int const index = published_.load();
+        readers_[index].fetch_add(1);
+        // a swap in between may have handed the buffer to the trainer already
+        if (published_.load() == index)
+            return index;
+        readers_[index].fetch_sub(1);
+    }
+}
+
+void online_trainer::run() {
+    while (true) {
+        while (sem_wait(&queued_) < 0 && errno == EINTR)
+            ;
+        if (stopping_)
+            return;
+
+        auto const head = head_.load(std::memory_order_relaxed);
+        if (tail_.load(std::memory_order_acquire) == head)
+            continue;
+        train(queue_[head % QUEUE_SIZE]);
+        head_.store(head + 1, std::memory_order_release);
+        publish();
+    }
+}
+
+void online_trainer::train(correction const &correction) {
+    auto const pixels = Eigen::Map<Eigen::VectorXf const>(correction.pixels.data(), correction.pixels.size());
+
+    auto const batch_size = replay_ ? x_.cols() : 1;
+    x_.col(0) = pixels;
+    digits_(0) = correction.digit;
+    for (size_t step = 0; step < options_.steps; step++) {
+        if (replay_) {
+            std::uniform_int_distribution<uint32_t> random(0, replay_->size() - 1);
+            for (auto &index : replay_indices_)
+                index = random(random_engine_);
+            replay_->get_batch(replay_indices_.data(), replay_indices_.size(), x_.rightCols(replay_indices_.size()));
+            for (size_t i = 0; i < replay_indices_.size(); i++)
+                digits_(i + 1) = replay_->digit(replay_indices_[i]);
+        }
+        training_.train_batch(digits_.head(batch_size), x_.leftCols(batch_size));
+    }
+}
+
+void online_trainer::publish() {
+    int const back = 1 - published_.load();
+    // readers that pinned it before the last swap
+    while (readers_[back].load() > 0)
+        std::this_thread::yield();
+    buffers_[back]->copy_coefficients(training_);
+    published_.store(back);
+    version_++;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <semaphore.h>
+#include <Eigen/Eigen>
+
+#include "dataset.h"
+#include "digit_image.h"
+#include "neural_network.h"
+
+// Fine-tunes a copy of a network on user corrections on a background thread.
+//
+// correct() copies a sample into a single producer, single consumer ring and
+// returns without locking. The trainer trains every correction in a few small
+// batches, each filled up with replayed training images so the network
+// doesn't drift towards the last few drawings. The result is published into
+// the one of two buffers that is not published, then the published index is
+// swapped atomically. Readers pin the buffer they use, the trainer waits for
+// them to leave before it writes a buffer again.
+class online_trainer {
+public:
+    static constexpr size_t const QUEUE_SIZE = 16;
+
+    struct options {
+        // the correction and batch_size - 1 replayed images
+        size_t batch_size = 8;
+        // batches per correction
+        size_t steps = 8;
+        float learning_rate = 0.1f;
+        // of the replayed image picks
+        uint64_t seed = 1;
+    };
+
+    // replay may be null, corrections train alone then
+    online_trainer(neural_network const &nn, dataset const *replay, options const &options);
+    ~online_trainer();
+
+    online_trainer(online_trainer const&) = delete;
+    online_trainer& operator=(online_trainer const&) = delete;
+
+    // false when the queue is full
+    bool correct(int digit, Eigen::Ref<Eigen::MatrixXf const> const &pixels);
+
+    // calls function(nn) with the latest published network
+    template <typename Function>
+    auto read(Function &&function) const {
+        auto const index = pin();
+        unpin_guard guard{readers_[index]};
+        return function(static_cast<neural_network const&>(*buffers_[index]));
+    }
+
+    // incremented with every publication
+    uint64_t version() const { return version_.load(); }
+
+private:
+    struct correction {
+        int digit;
+        std::array<float, digit_image::IMAGE_SIZE> pixels;
+    };
+
+    struct unpin_guard {
+        std::atomic<int> &readers;
+        ~unpin_guard() { readers.fetch_sub(1); }
+    };
+
+    int pin() const;
+    void run();
+    void train(correction const &correction);
+    void publish();
+
+    options options_;
+    dataset const *replay_;
+    neural_network training_;
+    std::default_random_engine random_engine_;
+    Eigen::VectorXi digits_;
+    Eigen::MatrixXf x_;
+    std::vector<uint32_t> replay_indices_;
+
+    std::array<correction, QUEUE_SIZE> queue_;
+    // corrections [head_, tail_) are queued
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+    // counts the queued corrections, wakes the trainer
+    sem_t queued_;
+
+    std::unique_ptr<neural_network> buffers_[2];
+    std::atomic<int> published_;
+    mutable std::atomic<int> readers_[2];
+    std::atomic<uint64_t> version_;
+
+    std::atomic<bool> stopping_;
+    std::thread trainer_;
+};
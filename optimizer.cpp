@@ -0,0 +1,44 @@
+#include "optimizer.h"
+
+#include <stdexcept>
+
+#include "kernels.h"
+
+bool uses_first_moment(optimizer optimizer) {
+    return optimizer == optimizer::momentum || optimizer == optimizer::nesterov || optimizer == optimizer::adam;
+}
+
+bool uses_second_moment(optimizer optimizer) {
+    return optimizer == optimizer::rmsprop || optimizer == optimizer::adam;
+}
+
+void update_weights(optimizer_settings const &settings, float learning_rate, size_t samples, uint64_t step,
+                    float *w, float const *g, float *m, float *v, size_t count)
+{
+    kernels::get().update_weights(settings, learning_rate, samples, step, w, g, m, v, count);
+}
+
+std::string optimizer_name(optimizer optimizer) {
+    switch (optimizer) {
+        case optimizer::sgd: return "sgd";
+        case optimizer::momentum: return "momentum";
+        case optimizer::nesterov: return "nesterov";
+        case optimizer::rmsprop: return "rmsprop";
+        case optimizer::adam: return "adam";
+    }
+    throw std::out_of_range("invalid optimizer");
+}
+
+optimizer parse_optimizer(std::string const &name) {
+    if (name == "sgd")
+        return optimizer::sgd;
+    if (name == "momentum")
+        return optimizer::momentum;
+    if (name == "nesterov")
+        return optimizer::nesterov;
+    if (name == "rmsprop")
+        return optimizer::rmsprop;
+    if (name == "adam")
+        return optimizer::adam;
+    throw std::invalid_argument("invalid optimizer " + name);
+}
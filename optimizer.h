@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum class optimizer : uint32_t {
+    sgd = 0,
+    momentum = 1,
+    nesterov = 2,
+    rmsprop = 3,
+    adam = 4,
+};
+
+struct optimizer_settings {
+    optimizer kind = optimizer::sgd;
+    // of momentum and nesterov, the first moment decay of adam
+    float momentum = 0.9f;
+    // second moment decay of rmsprop and adam
+    float rmsprop_decay = 0.9f;
+    float adam_decay = 0.999f;
+    float epsilon = 1e-8f;
+};
+
+// first and second moment buffers the optimizer keeps per weight
+bool uses_first_moment(optimizer optimizer);
+bool uses_second_moment(optimizer optimizer);
+
+// One update of count weights w in a single fused pass. g is the gradient
+// summed over samples, pointing towards lower error. m and v are the
+// moment buffers, null when the optimizer doesn't use them. step counts the
+// updates from 1.
+void update_weights(optimizer_settings const &settings, float learning_rate, size_t samples, uint64_t step,
+                    float *w, float const *g, float *m, float *v, size_t count);
+
+std::string optimizer_name(optimizer optimizer);
+optimizer parse_optimizer(std::string const &name);
@@ -0,0 +1,70 @@
+#include "pruning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// 1 for the round((1 - sparsity) * size) highest scores, 0 for the rest
+static Eigen::MatrixXf keep_highest(Eigen::MatrixXf const &scores, float sparsity) {
+    auto const size = static_cast<size_t>(scores.size());
+    auto const pruned = std::min(size, static_cast<size_t>(std::lround(sparsity * size)));
+    Eigen::MatrixXf mask = Eigen::MatrixXf::Ones(scores.rows(), scores.cols());
+    if (pruned == 0)
+        return mask;
+
+    // ties at the threshold are broken by position, so exactly pruned go
+    std::vector<Eigen::Index> order(size);
+    for (size_t i = 0; i < size; i++)
+        order[i] = i;
+    std::nth_element(order.begin(), order.begin() + (pruned - 1), order.end(), [&](auto a, auto b) {
+        return scores(a) < scores(b) || (scores(a) == scores(b) && a < b);
+    });
+    for (size_t i = 0; i < pruned; i++)
+        mask(order[i]) = 0.0f;
+    return mask;
+}
+
+void prune(neural_network &nn, pruning criterion, float sparsity,
+           Eigen::Ref<Eigen::MatrixXf const> const &calibration)
+{
+    if (sparsity < 0.0f || sparsity >= 1.0f)
+        throw std::invalid_argument("sparsity must be in [0, 1)");
+    auto const layers = nn.layer_sizes().size();
+
+    neural_network::workspace ws;
+    if (criterion == pruning::activity) {
+        if (calibration.cols() == 0)
+            throw std::invalid_argument("activity pruning needs calibration samples");
+        nn.feed_forward(calibration, ws);
+    }
+
+    for (size_t layer = 1; layer + 1 < layers; layer++) {
+        Eigen::MatrixXf scores = nn.weights(layer).cwiseAbs();
+        if (criterion == pruning::activity) {
+            Eigen::VectorXf activity;
+            if (layer == 1)
+                activity = calibration.cwiseAbs().rowwise().mean();
+            else
+                activity = ws.as[layer - 1].leftCols(calibration.cols()).cwiseAbs().rowwise().mean();
+            scores.array().rowwise() *= activity.transpose().array();
+        }
+        nn.set_mask(layer, keep_highest(scores, sparsity));
+    }
+}
+
+std::string pruning_name(pruning criterion) {
+    switch (criterion) {
+        case pruning::magnitude: return "magnitude";
+        case pruning::activity: return "activity";
+    }
+    throw std::out_of_range("invalid pruning");
+}
+
+pruning parse_pruning(std::string const &name) {
+    if (name == "magnitude")
+        return pruning::magnitude;
+    if (name == "activity")
+        return pruning::activity;
+    throw std::invalid_argument("invalid pruning " + name);
+}
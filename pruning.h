@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <Eigen/Eigen>
+
+#include "neural_network.h"
+
+// Which weights pruning drops first.
+enum class pruning {
+    // the smallest |w|
+    magnitude,
+    // the smallest |w| * mean |input| over calibration samples, so weights
+    // of inputs that are never active, like the border pixels of the
+    // digits, go first
+    activity,
+};
+
+// Masks the lowest scoring weights of every layer but the output layer, the
+// fraction sparsity of each. calibration holds one sample per column and is
+// only used by pruning::activity.
+void prune(neural_network &nn, pruning criterion, float sparsity,
+           Eigen::Ref<Eigen::MatrixXf const> const &calibration);
+
+std::string pruning_name(pruning criterion);
+pruning parse_pruning(std::string const &name);
@@ -0,0 +1,225 @@
+#include "quantized_network.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "coefficient_file.h"
+#include "kernels.h"
+
+static int16_t quantize(float value, float scale) {
+    auto const q = std::clamp(value / scale, -127.0f, 127.0f);
+    // rounds half away from zero without a libm call, so the loops vectorize
+    return static_cast<int16_t>(q + (q < 0.0f ? -0.5f : 0.5f));
+}
+
+// the scale mapping [-max, max] onto [-127, 127]
+static float get_scale(float max) {
+    return max > 0.0f ? max / 127.0f : 1.0f;
+}
+
+bool quantized_network::is_quantized(std::istream &is) {
+    char magic[sizeof(MAGIC)] = {};
+    auto const position = is.tellg();
+    auto const exceptions = is.exceptions();
+    is.exceptions(std::istream::goodbit);
+    is.read(magic, sizeof(magic));
+    is.clear();
+    is.seekg(position);
+    is.exceptions(exceptions);
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+quantized_network::quantized_network(neural_network const &nn, Eigen::Ref<Eigen::MatrixXf const> const &calibration) {
+    auto const layer_sizes = nn.layer_sizes();
+    auto const &activations = nn.activations();
+
+    neural_network::workspace ws;
+    nn.feed_forward(calibration, ws);
+
+    for (size_t index = 1; index < layer_sizes.size(); index++) {
+        layer l;
+        l.inputs = layer_sizes[index - 1];
+        l.outputs = layer_sizes[index];
+        l.activation = activations[index];
+
+        // calibrated range of the layer inputs
+        if (index == 1)
+            l.input_scale = get_scale(calibration.cwiseAbs().maxCoeff());
+        else
+            l.input_scale = get_scale(ws.as[index - 1].leftCols(calibration.cols()).cwiseAbs().maxCoeff());
+
+        auto const &w = nn.weights(index);
+        auto const &b = nn.biases(index);
+        l.weights.resize(l.outputs * l.inputs);
+        l.row_scales.resize(l.outputs);
+        l.biases.assign(b.data(), b.data() + b.size());
+        for (size_t row = 0; row < l.outputs; row++) {
+            auto const scale = get_scale(w.row(row).cwiseAbs().maxCoeff());
+            l.row_scales[row] = scale;
+            for (size_t col = 0; col < l.inputs; col++)
+                l.weights[row * l.inputs + col] = static_cast<int8_t>(quantize(w(row, col), scale));
+        }
+        layers_.push_back(std::move(l));
+    }
+    build_lookup_tables();
+}
+
+quantized_network::quantized_network(std::istream &is) {
+    char magic[sizeof(MAGIC)];
+    uint32_t version, layers;
+    is.read(magic, sizeof(magic));
+    is.read(reinterpret_cast<char*>(&version), sizeof(version));
+    is.read(reinterpret_cast<char*>(&layers), sizeof(layers));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a quantized network file");
+    if (version != VERSION)
+        throw std::runtime_error("unsupported quantized network version " + std::to_string(version));
+    coefficient_file::check_layers(layers);
+
+    layers_.resize(layers);
+    for (auto &l : layers_) {
+        uint32_t inputs, outputs, activation;
+        is.read(reinterpret_cast<char*>(&inputs), sizeof(inputs));
+        is.read(reinterpret_cast<char*>(&outputs), sizeof(outputs));
+        is.read(reinterpret_cast<char*>(&activation), sizeof(activation));
+        is.read(reinterpret_cast<char*>(&l.input_scale), sizeof(l.input_scale));
+        coefficient_file::check_layer(inputs, outputs);
+        if (activation > static_cast<uint32_t>(activation::softmax))
+            throw std::runtime_error("invalid activation " + std::to_string(activation));
+        l.inputs = inputs;
+        l.outputs = outputs;
+        l.activation = static_cast<::activation>(activation);
+        l.weights.resize(l.outputs * l.inputs);
+        l.row_scales.resize(l.outputs);
+        l.biases.resize(l.outputs);
+        is.read(reinterpret_cast<char*>(l.row_scales.data()), l.row_scales.size() * sizeof(float));
+        is.read(reinterpret_cast<char*>(l.biases.data()), l.biases.size() * sizeof(float));
+        is.read(reinterpret_cast<char*>(l.weights.data()), l.weights.size());
+    }
+    for (size_t index = 1; index < layers_.size(); index++) {
+        if (layers_[index].inputs != layers_[index - 1].outputs)
+            throw std::runtime_error("inconsistent quantized network layers");
+    }
+    build_lookup_tables();
+}
+
+void quantized_network::save(std::ostream &os) const {
+    uint32_t const version = VERSION;
+    uint32_t const layers = layers_.size();
+    os.write(MAGIC, sizeof(MAGIC));
+    os.write(reinterpret_cast<char const*>(&version), sizeof(version));
+    os.write(reinterpret_cast<char const*>(&layers), sizeof(layers));
+    for (auto const &l : layers_) {
+        uint32_t const inputs = l.inputs;
+        uint32_t const outputs = l.outputs;
+        uint32_t const activation = static_cast<uint32_t>(l.activation);
+        os.write(reinterpret_cast<char const*>(&inputs), sizeof(inputs));
+        os.write(reinterpret_cast<char const*>(&outputs), sizeof(outputs));
+        os.write(reinterpret_cast<char const*>(&activation), sizeof(activation));
+        os.write(reinterpret_cast<char const*>(&l.input_scale), sizeof(l.input_scale));
+        os.write(reinterpret_cast<char const*>(l.row_scales.data()), l.row_scales.size() * sizeof(float));
+        os.write(reinterpret_cast<char const*>(l.biases.data()), l.biases.size() * sizeof(float));
+        os.write(reinterpret_cast<char const*>(l.weights.data()), l.weights.size());
+    }
+}
+
+int16_t quantized_network::quantize_output(layer const &l, float z, float output_scale) {
+    Eigen::Array<float, 1, 1> a;
+    a(0) = z;
+    switch (l.activation) {
+        case activation::sigmoid: a = sigmoid_activation::f(a); break;
+        case activation::tanh: a = tanh_activation::f(a); break;
+        case activation::relu: a = relu_activation::f(a); break;
+        case activation::softmax: throw std::runtime_error("softmax is only supported on the output layer");
+    }
+    return quantize(a(0), output_scale);
+}
+
+void quantized_network::build_lookup_tables() {
+    for (size_t index = 0; index + 1 < layers_.size(); index++) {
+        auto &l = layers_[index];
+        l.lut.clear();
+        if (l.activation == activation::relu)
+            continue;
+        l.lut.resize(LUT_SIZE);
+        for (int i = 0; i < LUT_SIZE; i++) {
+            float const z = (i + 0.5f) * (2.0f * LUT_RANGE / LUT_SIZE) - LUT_RANGE;
+            l.lut[i] = quantize_output(l, z, layers_[index + 1].input_scale);
+        }
+    }
+}
+
+size_t quantized_network::coefficients_size() const {
+    size_t size = 0;
+    for (auto const &l : layers_)
+        size += l.weights.size() * sizeof(int8_t) + (l.row_scales.size() + l.biases.size() + 1) * sizeof(float);
+    return size;
+}
+
+void quantized_network::reserve(workspace &ws, size_t batch_size) const {
+    if (ws.batch_size >= batch_size)
+        return;
+
+    size_t widest = 0;
+    for (auto const &l : layers_)
+        widest = std::max({widest, l.inputs, l.outputs});
+    ws.batch_size = batch_size;
+    ws.inputs.resize(widest * batch_size);
+    ws.outputs.resize(widest * batch_size);
+    ws.y.resize(layers_.back().outputs, batch_size);
+}
+
+Eigen::MatrixXf quantized_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const {
+    workspace ws;
+    return feed_forward(x, ws);
+}
+
+Eigen::MatrixXf::ConstColsBlockXpr quantized_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x,
+                                                                   workspace &ws) const
+{
+    size_t const batch_size = x.cols();
+    reserve(ws, batch_size);
+
+    auto inputs = ws.inputs.data();
+    auto outputs = ws.outputs.data();
+    for (size_t sample = 0; sample < batch_size; sample++) {
+        for (size_t i = 0; i < layers_.front().inputs; i++)
+            inputs[sample * layers_.front().inputs + i] = quantize(x(i, sample), layers_.front().input_scale);
+    }
+
+    auto const dot = kernels::get().quantized_dot;
+    auto result = ws.y.leftCols(batch_size);
+    for (size_t index = 0; index < layers_.size(); index++) {
+        auto const &l = layers_[index];
+        bool const last = index + 1 == layers_.size();
+        auto const output_scale = last ? 1.0f : layers_[index + 1].input_scale;
+
+        for (size_t row = 0; row < l.outputs; row++) {
+            auto const weights = l.weights.data() + row * l.inputs;
+            auto const scale = l.row_scales[row] * l.input_scale;
+            for (size_t sample = 0; sample < batch_size; sample++) {
+                auto const z = dot(weights, inputs + sample * l.inputs, l.inputs) * scale + l.biases[row];
+                if (last) {
+                    result(row, sample) = z;
+                } else if (l.lut.empty()) {
+                    outputs[sample * l.outputs + row] = quantize(std::max(z, 0.0f), output_scale);
+                } else {
+                    auto const i = static_cast<int>((z + LUT_RANGE) * (LUT_SIZE / (2.0f * LUT_RANGE)));
+                    outputs[sample * l.outputs + row] = l.lut[std::clamp(i, 0, LUT_SIZE - 1)];
+                }
+            }
+        }
+        if (last)
+            activate(l.activation, result);
+        std::swap(inputs, outputs);
+    }
+    return static_cast<Eigen::MatrixXf const&>(ws.y).leftCols(batch_size);
+}
+
+int quantized_network::get_digit(Eigen::MatrixXf const &x, workspace &ws) const {
+    Eigen::Index max_coeff;
+    feed_forward(x, ws).col(0).maxCoeff(&max_coeff);
+    return max_coeff;
+}
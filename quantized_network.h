@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "activation.h"
+#include "neural_network.h"
+
+// Post-training int8 quantization of a neural_network for inference.
+//
+// Weights are int8 with one float scale per row, activations between layers
+// are int8 with one scale per layer calibrated on sample inputs. Layers
+// multiply in integers, dequantize once per output and produce the next
+// layer's int8 inputs through a lookup table (sigmoid, tanh) or directly
+// (relu). The output layer stays float.
+//
+// Weights are int8 in files and in memory, activations between layers are
+// held as int16: the baseline x86-64 target has no int8 multiply-add, the
+// dot products widen the weights as they load them and compile to pmaddwd.
+class quantized_network {
+public:
+    static constexpr char const MAGIC[8] = {'N', 'N', 'N', 'U', 'M', 'Q', '8', '\0'};
+    static constexpr uint32_t const VERSION = 1;
+    static constexpr int const LUT_SIZE = 4096;
+    // the table covers pre-activations in [-LUT_RANGE, LUT_RANGE]
+    static constexpr float const LUT_RANGE = 8.0f;
+
+    // peeks at the magic, leaves the stream position unchanged
+    static bool is_quantized(std::istream &is);
+
+    // calibration holds one sample per column
+    quantized_network(neural_network const &nn, Eigen::Ref<Eigen::MatrixXf const> const &calibration);
+    explicit quantized_network(std::istream &is);
+
+    void save(std::ostream &os) const;
+
+    // buffers for up to batch_size samples
+    struct workspace {
+        size_t batch_size = 0;
+        // quantized inputs and outputs of the current layer, one sample
+        // after another
+        std::vector<int16_t> inputs;
+        std::vector<int16_t> outputs;
+        Eigen::MatrixXf y;
+    };
+
+    void reserve(workspace &ws, size_t batch_size) const;
+
+    // x holds one sample per column
+    Eigen::MatrixXf feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const;
+    // the result lives in ws
+    Eigen::MatrixXf::ConstColsBlockXpr feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const;
+    int get_digit(Eigen::MatrixXf const &x, workspace &ws) const;
+
+    size_t inputs() const { return layers_.front().inputs; }
+    size_t outputs() const { return layers_.back().outputs; }
+
+    // bytes of the weights, scales and biases
+    size_t coefficients_size() const;
+
+private:
+    struct layer {
+        size_t inputs;
+        size_t outputs;
+        ::activation activation;
+        // real input = int8 input * input_scale
+        float input_scale;
+        // outputs x inputs, row-major
+        std::vector<int8_t> weights;
+        std::vector<float> row_scales;
+        std::vector<float> biases;
+        // int8 output for the next layer by pre-activation
+        std::vector<int16_t> lut;
+    };
+
+    void build_lookup_tables();
+    // quantizes the pre-activations of a hidden layer onto output_scale
+    static int16_t quantize_output(layer const &l, float z, float output_scale);
+
+    std::vector<layer> layers_;
+};
@@ -0,0 +1,259 @@
+#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// false at the end of the stream
+static bool read_all(int fd, void *data, size_t size) {
+    auto bytes = static_cast<char*>(data);
+    while (size > 0) {
+        auto const result = read(fd, bytes, size);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        bytes += result;
+        size -= result;
+    }
+    return true;
+}
+
+static bool write_all(int fd, void const *data, size_t size) {
+    auto bytes = static_cast<char const*>(data);
+    while (size > 0) {
+        auto const result = write(fd, bytes, size);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        bytes += result;
+        size -= result;
+    }
+    return true;
+}
+
+server::server(neural_network const &nn, options const &options)
+    : nn_(nn)
+    , options_(options)
+    , stopping_(false)
+    , batches_(0)
+    , report_start_(std::chrono::steady_clock::now())
+{
+    options_.max_batch = std::max<size_t>(options_.max_batch, 1);
+    // a client going away must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+    for (size_t i = 0; i < std::max<size_t>(options_.workers, 1); i++)
+        workers_.emplace_back(&server::work, this);
+}
+
+server::~server() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    for (auto &worker : workers_)
+        worker.join();
+    record({});
+}
+
+void server::serve(int input, int output) {
+    connection connection;
+    connection.input = input;
+    connection.output = output;
+    std::thread writer(&server::write_replies, this, std::ref(connection));
+    read_requests(connection);
+    writer.join();
+}
+
+void server::listen(std::string const &path) {
+    int const fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("failed to create a socket");
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long");
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        throw std::runtime_error("failed to listen on " + path);
+    }
+    std::cerr << "listening on " << path << '\n';
+
+    while (true) {
+        int const client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("failed to accept a connection");
+        }
+        std::thread([this, client] {
+            serve(client, client);
+            close(client);
+        }).detach();
+    }
+}
+
+void server::read_requests(connection &connection) {
+    while (true) {
+        request *request;
+        {
+            std::unique_lock<std::mutex> lock(connection.mutex);
+            connection.changed.wait(lock, [&] { return connection.count < MAX_IN_FLIGHT; });
+            request = &connection.requests[(connection.first + connection.count) % MAX_IN_FLIGHT];
+        }
+
+        // the slot isn't in flight, nobody else touches it
+        if (!read_all(connection.input, request->pixels.data(), request->pixels.size()))
+            break;
+        request->owner = &connection;
+        request->arrival = std::chrono::steady_clock::now();
+        request->done = false;
+
+        {
+            std::lock_guard<std::mutex> lock(connection.mutex);
+            connection.count++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(request);
+        }
+        queued_.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    connection.closed = true;
+    connection.changed.notify_all();
+}
+
+void server::write_replies(connection &connection) {
+    char reply[REPLY_SIZE];
+    bool writable = true;
+    while (true) {
+        request *request;
+        {
+            std::unique_lock<std::mutex> lock(connection.mutex);
+            connection.changed.wait(lock, [&] {
+                return (connection.count > 0 && connection.requests[connection.first].done)
+                    || (connection.count == 0 && connection.closed);
+            });
+            if (connection.count == 0)
+                return;
+            request = &connection.requests[connection.first];
+        }
+
+        std::memcpy(reply, &request->digit, sizeof(request->digit));
+        std::memcpy(reply + sizeof(request->digit), request->scores.data(), sizeof(request->scores));
+        // keeps draining when the client has gone, the reader ends by itself
+        if (writable)
+            writable = write_all(connection.output, reply, sizeof(reply));
+
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        connection.first = (connection.first + 1) % MAX_IN_FLIGHT;
+        connection.count--;
+        connection.changed.notify_all();
+    }
+}
+
+void server::work() {
+    std::vector<request*> batch;
+    batch.reserve(options_.max_batch);
+    Eigen::MatrixXf x(digit_image::IMAGE_SIZE, options_.max_batch);
+    neural_network::workspace ws;
+    nn_.reserve(ws, options_.max_batch);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // until the batch is full or its oldest request is due
+            while (true) {
+                queued_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (stopping_)
+                    return;
+                if (queue_.size() >= options_.max_batch)
+                    break;
+                auto const due = queue_.front()->arrival + options_.deadline;
+                if (std::chrono::steady_clock::now() >= due)
+                    break;
+                queued_.wait_until(lock, due);
+            }
+
+            batch.clear();
+            while (!queue_.empty() && batch.size() < options_.max_batch) {
+                batch.push_back(queue_.front());
+                queue_.pop_front();
+            }
+        }
+        // the rest is due as well
+        queued_.notify_one();
+
+        run_batch(batch, x, ws);
+        record(batch);
+
+        for (auto request : batch) {
+            auto &connection = *request->owner;
+            std::lock_guard<std::mutex> lock(connection.mutex);
+            request->done = true;
+            connection.changed.notify_all();
+        }
+    }
+}
+
+void server::run_batch(std::vector<request*> const &batch, Eigen::MatrixXf &x, neural_network::workspace &ws) {
+    auto const size = batch.size();
+    for (size_t i = 0; i < size; i++) {
+        auto const &pixels = batch[i]->pixels;
+        for (size_t pixel = 0; pixel < pixels.size(); pixel++)
+            x(pixel, i) = pixels[pixel] / 255.0f;
+    }
+
+    auto const ys = nn_.feed_forward(x.leftCols(size), ws);
+    for (size_t i = 0; i < size; i++) {
+        Eigen::Index digit;
+        ys.col(i).maxCoeff(&digit);
+        batch[i]->digit = digit;
+        for (size_t score = 0; score < 10; score++)
+            batch[i]->scores[score] = ys(score, i);
+    }
+}
+
+void server::record(std::vector<request*> const &batch) {
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    for (auto request : batch)
+        latencies_.push_back(std::chrono::duration<float, std::micro>(now - request->arrival).count());
+    if (!batch.empty())
+        batches_++;
+
+    // an empty batch flushes the report
+    std::chrono::duration<float> const elapsed = now - report_start_;
+    if ((batch.empty() || elapsed >= options_.report_interval) && !latencies_.empty()) {
+        auto const percentile = [&](float p) {
+            auto const n = static_cast<size_t>(p * (latencies_.size() - 1));
+            std::nth_element(latencies_.begin(), latencies_.begin() + n, latencies_.end());
+            return latencies_[n];
+        };
+        auto const requests = latencies_.size();
+        auto const p50 = percentile(0.5f);
+        auto const p99 = percentile(0.99f);
+        std::cerr
+            << requests << " requests in " << batches_ << " batches"
+            << ", mean batch " << static_cast<float>(requests) / batches_
+            << ", " << requests / elapsed.count() << " requests/s"
+            << ", p50 " << p50 << " us, p99 " << p99 << " us\n";
+        latencies_.clear();
+        batches_ = 0;
+        report_start_ = now;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "digit_image.h"
+#include "neural_network.h"
+
+// Headless inference server with dynamic batching.
+//
+// Clients send raw images and read back replies on the same stream, in
+// request order. Requests may be pipelined. A request is IMAGE_SIZE bytes,
+// one pixel per byte, row by row, as in the MNIST files. A reply is
+// REPLY_SIZE bytes, native byte order:
+//   int32_t digit
+//   float scores[10]
+//
+// Requests of all connections are queued and the workers take them in
+// batches. A batch is dispatched once max_batch requests are waiting or the
+// oldest waited for deadline.
+class server {
+public:
+    static constexpr size_t const REQUEST_SIZE = digit_image::IMAGE_SIZE;
+    static constexpr size_t const REPLY_SIZE = sizeof(int32_t) + 10 * sizeof(float);
+    // unanswered requests per connection before reading pauses
+    static constexpr size_t const MAX_IN_FLIGHT = 64;
+
+    struct options {
+        size_t max_batch = 32;
+        std::chrono::microseconds deadline{1000};
+        size_t workers = 1;
+        // between the latency reports on stderr
+        std::chrono::seconds report_interval{10};
+    };
+
+    server(neural_network const &nn, options const &options);
+    ~server();
+
+    server(server const&) = delete;
+    server& operator=(server const&) = delete;
+
+    // serves one connection until input ends, e.g. stdin and stdout
+    void serve(int input, int output);
+    // accepts connections on a Unix domain socket, doesn't return
+    void listen(std::string const &path);
+
+private:
+    struct connection;
+
+    struct request {
+        connection *owner;
+        std::array<uint8_t, REQUEST_SIZE> pixels;
+        std::chrono::steady_clock::time_point arrival;
+        int32_t digit;
+        std::array<float, 10> scores;
+        bool done;
+    };
+
+    // reading and replying to one stream
+    struct connection {
+        int input;
+        int output;
+        std::array<request, MAX_IN_FLIGHT> requests;
+        // requests [first, first + count) of the ring are in flight
+        size_t first = 0;
+        size_t count = 0;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable changed;
+    };
+
+    void read_requests(connection &connection);
+    void write_replies(connection &connection);
+    void work();
+    void run_batch(std::vector<request*> const &batch, Eigen::MatrixXf &x, neural_network::workspace &ws);
+    void record(std::vector<request*> const &batch);
+
+    neural_network const &nn_;
+    options options_;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::deque<request*> queue_;
+    bool stopping_;
+    std::vector<std::thread> workers_;
+
+    // latencies in microseconds since the last report
+    std::mutex stats_mutex_;
+    std::vector<float> latencies_;
+    size_t batches_;
+    std::chrono::steady_clock::time_point report_start_;
+};
@@ -0,0 +1,260 @@
+#include "sparse_network.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "coefficient_file.h"
+#include "kernels.h"
+
+bool sparse_network::is_sparse(std::istream &is) {
+    char magic[sizeof(MAGIC)] = {};
+    auto const position = is.tellg();
+    auto const exceptions = is.exceptions();
+    is.exceptions(std::istream::goodbit);
+    is.read(magic, sizeof(magic));
+    is.clear();
+    is.seekg(position);
+    is.exceptions(exceptions);
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+sparse_network::sparse_network(neural_network const &nn, float max_density) {
+    auto const layer_sizes = nn.layer_sizes();
+    auto const &activations = nn.activations();
+
+    for (size_t index = 1; index < layer_sizes.size(); index++) {
+        layer l;
+        l.inputs = layer_sizes[index - 1];
+        l.outputs = layer_sizes[index];
+        l.activation = activations[index];
+        l.biases = nn.biases(index);
+
+        auto const &w = nn.weights(index);
+        auto const nonzeros = (w.array() != 0.0f).count();
+        bool const sparse = nonzeros <= max_density * w.size()
+            && l.inputs <= std::numeric_limits<uint16_t>::max();
+        l.format = sparse ? format::csr : format::dense;
+        if (sparse) {
+            l.csr = w.sparseView();
+            l.csr.makeCompressed();
+        } else
+            l.dense = w;
+        layers_.push_back(std::move(l));
+    }
+}
+
+sparse_network::sparse_network(std::istream &is) {
+    char magic[sizeof(MAGIC)];
+    uint32_t version, layers;
+    is.read(magic, sizeof(magic));
+    is.read(reinterpret_cast<char*>(&version), sizeof(version));
+    is.read(reinterpret_cast<char*>(&layers), sizeof(layers));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a sparse network file");
+    if (version != VERSION)
+        throw std::runtime_error("unsupported sparse network version " + std::to_string(version));
+    coefficient_file::check_layers(layers);
+
+    layers_.resize(layers);
+    for (auto &l : layers_) {
+        uint32_t inputs, outputs, activation, format;
+        is.read(reinterpret_cast<char*>(&inputs), sizeof(inputs));
+        is.read(reinterpret_cast<char*>(&outputs), sizeof(outputs));
+        is.read(reinterpret_cast<char*>(&activation), sizeof(activation));
+        is.read(reinterpret_cast<char*>(&format), sizeof(format));
+        coefficient_file::check_layer(inputs, outputs);
+        if (activation > static_cast<uint32_t>(activation::softmax))
+            throw std::runtime_error("invalid activation " + std::to_string(activation));
+        if (format > static_cast<uint32_t>(format::csr))
+            throw std::runtime_error("invalid sparse layer format " + std::to_string(format));
+        l.inputs = inputs;
+        l.outputs = outputs;
+        l.activation = static_cast<::activation>(activation);
+        l.format = static_cast<sparse_network::format>(format);
+        l.biases.resize(outputs);
+        is.read(reinterpret_cast<char*>(l.biases.data()), l.biases.size() * sizeof(float));
+
+        if (l.format == format::dense) {
+            l.dense.resize(outputs, inputs);
+            is.read(reinterpret_cast<char*>(l.dense.data()), l.dense.size() * sizeof(float));
+            continue;
+        }
+        uint32_t nonzeros;
+        is.read(reinterpret_cast<char*>(&nonzeros), sizeof(nonzeros));
+        if (nonzeros > uint64_t(inputs) * outputs)
+            throw std::runtime_error("more nonzeros than sparse layer weights");
+        std::vector<uint32_t> offsets(outputs + 1);
+        std::vector<uint16_t> columns(nonzeros);
+        is.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        is.read(reinterpret_cast<char*>(columns.data()), columns.size() * sizeof(uint16_t));
+        if (offsets.front() != 0 || offsets.back() != nonzeros)
+            throw std::runtime_error("inconsistent sparse layer offsets");
+
+        l.csr.resize(outputs, inputs);
+        l.csr.resizeNonZeros(nonzeros);
+        is.read(reinterpret_cast<char*>(l.csr.valuePtr()), nonzeros * sizeof(float));
+        for (size_t row = 0; row <= outputs; row++) {
+            if (row > 0 && offsets[row] < offsets[row - 1])
+                throw std::runtime_error("inconsistent sparse layer offsets");
+            l.csr.outerIndexPtr()[row] = offsets[row];
+        }
+        for (size_t i = 0; i < nonzeros; i++) {
+            if (columns[i] >= inputs)
+                throw std::runtime_error("sparse layer column out of range");
+            l.csr.innerIndexPtr()[i] = columns[i];
+        }
+    }
+    for (size_t index = 1; index < layers_.size(); index++) {
+        if (layers_[index].inputs != layers_[index - 1].outputs)
+            throw std::runtime_error("inconsistent sparse network layers");
+    }
+}
+
+void sparse_network::save(std::ostream &os) const {
+    uint32_t const version = VERSION;
+    uint32_t const layers = layers_.size();
+    os.write(MAGIC, sizeof(MAGIC));
+    os.write(reinterpret_cast<char const*>(&version), sizeof(version));
+    os.write(reinterpret_cast<char const*>(&layers), sizeof(layers));
+    for (auto const &l : layers_) {
+        uint32_t const inputs = l.inputs;
+        uint32_t const outputs = l.outputs;
+        uint32_t const activation = static_cast<uint32_t>(l.activation);
+        uint32_t const format = static_cast<uint32_t>(l.format);
+        os.write(reinterpret_cast<char const*>(&inputs), sizeof(inputs));
+        os.write(reinterpret_cast<char const*>(&outputs), sizeof(outputs));
+        os.write(reinterpret_cast<char const*>(&activation), sizeof(activation));
+        os.write(reinterpret_cast<char const*>(&format), sizeof(format));
+        os.write(reinterpret_cast<char const*>(l.biases.data()), l.biases.size() * sizeof(float));
+
+        if (l.format == format::dense) {
+            os.write(reinterpret_cast<char const*>(l.dense.data()), l.dense.size() * sizeof(float));
+            continue;
+        }
+        uint32_t const nonzeros = l.csr.nonZeros();
+        std::vector<uint32_t> const offsets(l.csr.outerIndexPtr(), l.csr.outerIndexPtr() + l.outputs + 1);
+        std::vector<uint16_t> const columns(l.csr.innerIndexPtr(), l.csr.innerIndexPtr() + nonzeros);
+        os.write(reinterpret_cast<char const*>(&nonzeros), sizeof(nonzeros));
+        os.write(reinterpret_cast<char const*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        os.write(reinterpret_cast<char const*>(columns.data()), columns.size() * sizeof(uint16_t));
+        os.write(reinterpret_cast<char const*>(l.csr.valuePtr()), nonzeros * sizeof(float));
+    }
+}
+
+size_t sparse_network::coefficients_size() const {
+    size_t size = 0;
+    for (auto const &l : layers_) {
+        size += l.biases.size() * sizeof(float);
+        if (l.format == format::dense)
+            size += l.dense.size() * sizeof(float);
+        else
+            size += (l.outputs + 1) * sizeof(uint32_t) + l.csr.nonZeros() * (sizeof(uint16_t) + sizeof(float));
+    }
+    return size;
+}
+
+float sparse_network::density() const {
+    size_t nonzeros = 0, weights = 0;
+    for (auto const &l : layers_) {
+        weights += l.inputs * l.outputs;
+        nonzeros += l.format == format::dense ? (l.dense.array() != 0.0f).count() : l.csr.nonZeros();
+    }
+    return static_cast<float>(nonzeros) / weights;
+}
+
+size_t sparse_network::sparse_layers() const {
+    size_t count = 0;
+    for (auto const &l : layers_)
+        count += l.format == format::csr;
+    return count;
+}
+
+void sparse_network::reserve(workspace &ws, size_t batch_size) const {
+    if (ws.batch_size >= batch_size && ws.as.size() == layers_.size())
+        return;
+
+    ws.batch_size = batch_size;
+    ws.as.resize(layers_.size());
+    ws.inputs.resize(layers_.size());
+    bool rows = false;
+    for (size_t index = 0; index < layers_.size(); index++) {
+        auto const &l = layers_[index];
+        bool const csr = l.format == format::csr;
+        if (csr != rows) {
+            if (csr)
+                ws.inputs[index].resize(batch_size, l.inputs);
+            else
+                ws.inputs[index].resize(l.inputs, batch_size);
+        }
+        if (csr)
+            ws.as[index].resize(batch_size, l.outputs);
+        else
+            ws.as[index].resize(l.outputs, batch_size);
+        rows = csr;
+    }
+    ws.y.resize(layers_.back().outputs, batch_size);
+}
+
+Eigen::MatrixXf sparse_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const {
+    workspace ws;
+    return feed_forward(x, ws);
+}
+
+Eigen::MatrixXf::ConstColsBlockXpr sparse_network::feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x,
+                                                                workspace &ws) const
+{
+    using const_matrix = Eigen::Map<Eigen::MatrixXf const, Eigen::Unaligned, Eigen::OuterStride<>>;
+    auto const batch_size = x.cols();
+    reserve(ws, batch_size);
+    auto const &kernels = kernels::get();
+
+    // dense layers take the samples in columns, CSR layers in rows
+    float const *input = x.data();
+    size_t stride = x.outerStride();
+    bool rows = false;
+    for (size_t index = 0; index < layers_.size(); index++) {
+        auto const &l = layers_[index];
+        bool const csr = l.format == format::csr;
+        if (csr != rows) {
+            auto &transposed = ws.inputs[index];
+            if (csr)
+                transposed.topRows(batch_size).noalias() = const_matrix(input, l.inputs, batch_size,
+                                                                        Eigen::OuterStride<>(stride)).transpose();
+            else
+                transposed.leftCols(batch_size).noalias() = const_matrix(input, batch_size, l.inputs,
+                                                                         Eigen::OuterStride<>(stride)).transpose();
+            input = transposed.data();
+            stride = transposed.outerStride();
+        }
+
+        auto &a = ws.as[index];
+        if (csr) {
+            kernels.sparse_forward(l.csr.outerIndexPtr(), l.csr.innerIndexPtr(), l.csr.valuePtr(), l.biases.data(),
+                                   l.outputs, input, stride, a.data(), a.outerStride(), batch_size);
+            // softmax normalizes samples, the columns of y
+            if (l.activation != activation::softmax)
+                kernels.activate(l.activation, a.data(), batch_size, l.outputs, a.outerStride());
+        } else {
+            kernels.forward(l.dense.data(), l.biases.data(), l.outputs, l.inputs, input, stride,
+                            a.data(), a.outerStride(), batch_size, l.activation);
+        }
+        input = a.data();
+        stride = a.outerStride();
+        rows = csr;
+    }
+
+    if (!rows)
+        return static_cast<Eigen::MatrixXf const&>(ws.as.back()).leftCols(batch_size);
+    auto const &last = layers_.back();
+    ws.y.leftCols(batch_size).noalias() = ws.as.back().topRows(batch_size).transpose();
+    if (last.activation == activation::softmax)
+        kernels.activate(last.activation, ws.y.data(), last.outputs, batch_size, ws.y.outerStride());
+    return static_cast<Eigen::MatrixXf const&>(ws.y).leftCols(batch_size);
+}
+
+int sparse_network::get_digit(Eigen::MatrixXf const &x, workspace &ws) const {
+    Eigen::Index max_coeff;
+    feed_forward(x, ws).col(0).maxCoeff(&max_coeff);
+    return max_coeff;
+}
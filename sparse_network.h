@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <Eigen/Eigen>
+#include <Eigen/SparseCore>
+
+#include "activation.h"
+#include "neural_network.h"
+
+// Inference on a pruned neural_network.
+//
+// Layers with few enough nonzero weights multiply in CSR, the rest stay
+// dense. Files store a CSR layer as its row offsets, 16-bit column indices
+// and the nonzero values, about 6 bytes per kept weight against 4 per
+// weight dense.
+class sparse_network {
+public:
+    static constexpr char const MAGIC[8] = {'N', 'N', 'N', 'U', 'M', 'S', 'P', '\0'};
+    static constexpr uint32_t const VERSION = 1;
+    // denser layers stay dense: single images, what the files are loaded
+    // for, only run faster in CSR from about 97% sparsity on, batches of 16
+    // from 80%, see the bench and the latencies of prune
+    static constexpr float const MAX_SPARSE_DENSITY = 0.03f;
+
+    // peeks at the magic, leaves the stream position unchanged
+    static bool is_sparse(std::istream &is);
+
+    // layers up to max_density go CSR
+    explicit sparse_network(neural_network const &nn, float max_density = MAX_SPARSE_DENSITY);
+    explicit sparse_network(std::istream &is);
+
+    void save(std::ostream &os) const;
+
+    // buffers for up to batch_size samples, one per layer like layers_
+    struct workspace {
+        size_t batch_size = 0;
+        // outputs in the layer's layout, samples in columns for dense
+        // layers and in rows for CSR ones
+        std::vector<Eigen::MatrixXf> as;
+        // the input transposed, for layers whose layout differs from the
+        // previous one's
+        std::vector<Eigen::MatrixXf> inputs;
+        // the outputs, samples in columns, when the last layer is CSR
+        Eigen::MatrixXf y;
+    };
+
+    void reserve(workspace &ws, size_t batch_size) const;
+
+    // x holds one sample per column
+    Eigen::MatrixXf feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x) const;
+    // the result lives in ws
+    Eigen::MatrixXf::ConstColsBlockXpr feed_forward(Eigen::Ref<Eigen::MatrixXf const> const &x, workspace &ws) const;
+    int get_digit(Eigen::MatrixXf const &x, workspace &ws) const;
+
+    size_t inputs() const { return layers_.front().inputs; }
+    size_t outputs() const { return layers_.back().outputs; }
+
+    // bytes of the weights, their indices and the biases as stored
+    size_t coefficients_size() const;
+    // nonzero weights of all layers over all weights
+    float density() const;
+    size_t sparse_layers() const;
+
+private:
+    enum class format : uint32_t {
+        dense = 0,
+        csr = 1,
+    };
+
+    struct layer {
+        size_t inputs;
+        size_t outputs;
+        ::activation activation;
+        sparse_network::format format;
+        // by format
+        Eigen::MatrixXf dense;
+        Eigen::SparseMatrix<float, Eigen::RowMajor, int32_t> csr;
+        Eigen::VectorXf biases;
+    };
+
+    std::vector<layer> layers_;
+};
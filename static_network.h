@@ -0,0 +1,247 @@
+#pragma once
+
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <Eigen/Eigen>
+
+#include "activation.h"
+#include "coefficient_file.h"
+#include "kernels.h"
+
+// A network whose topology is fixed at compile time, e.g.
+// static_network<784, 196, 49, 10>. Reads and writes the same coefficient
+// files as neural_network.
+//
+// The fixed sizes buy shape checks by the compiler, not speed: the products
+// run on the dispatched kernels like neural_network's, see kernels.h.
+// Loops specialized on the sizes and cloned per instruction set took 13 us
+// for the products of that network alone, against 11 us for the kernels'
+// whole forward pass, which the weights' memory traffic bounds.
+template <int... Sizes>
+class static_network {
+public:
+    static constexpr int LAYERS = sizeof...(Sizes);
+    static constexpr std::array<int, LAYERS> SIZES = {Sizes...};
+    static constexpr int INPUTS = SIZES.front();
+    static constexpr int OUTPUTS = SIZES.back();
+
+    static_assert(LAYERS >= 2, "minimum layer count is 2");
+
+    template <int Layer>
+    using vector = Eigen::Matrix<float, SIZES[Layer], 1>;
+    template <int Layer>
+    using weights = Eigen::Matrix<float, SIZES[Layer], SIZES[Layer - 1]>;
+
+    using input = vector<0>;
+    using output = vector<LAYERS - 1>;
+
+    explicit static_network(float learning_rate)
+        : learning_rate_(learning_rate)
+        , storage_(static_cast<float*>(std::aligned_alloc(ALIGNMENT, STORAGE_SIZE * sizeof(float))), &std::free)
+        , gradients_(static_cast<float*>(std::aligned_alloc(ALIGNMENT, STORAGE_SIZE * sizeof(float))), &std::free)
+    {
+        if (storage_ == nullptr || gradients_ == nullptr)
+            throw std::bad_alloc();
+        activations_.fill(activation::sigmoid);
+        randomize<1>();
+    }
+
+    static_network(static_network const &other)
+        : static_network(other.learning_rate_)
+    {
+        activations_ = other.activations_;
+        std::copy(other.storage_.get(), other.storage_.get() + STORAGE_SIZE, storage_.get());
+    }
+
+    // detects the text and the binary formats
+    void read_coefficients(std::istream &is) {
+        if (!coefficient_file::is_binary(is)) {
+            read_text<1>(is, true);
+            read_text<1>(is, false);
+            return;
+        }
+
+        auto const topology = coefficient_file::read_header(is);
+        if (topology.layer_sizes != std::vector<size_t>(SIZES.begin(), SIZES.end()))
+            throw std::runtime_error("coefficients topology does not match the network");
+        std::copy(topology.activations.begin(), topology.activations.end(), activations_.begin());
+        read_binary<1>(is);
+    }
+
+    void save_binary_coefficients(std::ostream &os) const {
+        coefficient_file::write_header(os, {
+            std::vector<size_t>(SIZES.begin(), SIZES.end()),
+            std::vector<activation>(activations_.begin(), activations_.end()),
+        });
+        save_binary<1>(os);
+    }
+
+    output feed_forward(input const &x) const {
+        activation_vectors as;
+        std::get<0>(as) = x;
+        forward<1>(as);
+        return std::get<LAYERS - 1>(as);
+    }
+
+    int get_digit(input const &x) const {
+        Eigen::Index max_coeff;
+        feed_forward(x).maxCoeff(&max_coeff);
+        return max_coeff;
+    }
+
+    void train(int digit, input const &x) {
+        activation_vectors as;
+        std::get<0>(as) = x;
+        forward<1>(as);
+
+        output error = -std::get<LAYERS - 1>(as);
+        error(digit) += 1.0f;
+        backward<LAYERS - 1>(as, error);
+    }
+
+    float get_learning_rate() const { return learning_rate_; }
+    void set_learning_rate(float rate) { learning_rate_ = rate; }
+
+    activation get_activation(int layer) const { return activations_.at(layer); }
+    void set_activation(int layer, activation activation) { activations_.at(layer) = activation; }
+
+private:
+    static constexpr size_t ALIGNMENT = coefficient_file::ALIGNMENT;
+    static constexpr size_t ALIGNMENT_FLOATS = ALIGNMENT / sizeof(float);
+
+    static constexpr size_t align(size_t count) {
+        return (count + ALIGNMENT_FLOATS - 1) / ALIGNMENT_FLOATS * ALIGNMENT_FLOATS;
+    }
+
+    // float offsets into storage_ of the weights and the biases of every layer
+    static constexpr std::array<size_t, LAYERS + 1> get_offsets() {
+        std::array<size_t, LAYERS + 1> offsets{};
+        for (int layer = 1; layer < LAYERS; layer++)
+            offsets[layer + 1] = offsets[layer] + align(SIZES[layer] * SIZES[layer - 1]) + align(SIZES[layer]);
+        return offsets;
+    }
+    static constexpr std::array<size_t, LAYERS + 1> OFFSETS = get_offsets();
+    static constexpr size_t STORAGE_SIZE = OFFSETS[LAYERS];
+
+    template <typename Indices>
+    struct vectors;
+    template <size_t... Layers>
+    struct vectors<std::index_sequence<Layers...>> {
+        using type = std::tuple<vector<Layers>...>;
+    };
+    using activation_vectors = typename vectors<std::make_index_sequence<LAYERS>>::type;
+
+    template <int Layer>
+    Eigen::Map<weights<Layer>, Eigen::Aligned64> w() {
+        return Eigen::Map<weights<Layer>, Eigen::Aligned64>(storage_.get() + OFFSETS[Layer]);
+    }
+    template <int Layer>
+    Eigen::Map<weights<Layer> const, Eigen::Aligned64> w() const {
+        return Eigen::Map<weights<Layer> const, Eigen::Aligned64>(storage_.get() + OFFSETS[Layer]);
+    }
+    template <int Layer>
+    Eigen::Map<vector<Layer>, Eigen::Aligned64> b() {
+        return Eigen::Map<vector<Layer>, Eigen::Aligned64>(storage_.get() + OFFSETS[Layer] + align(SIZES[Layer] * SIZES[Layer - 1]));
+    }
+    template <int Layer>
+    Eigen::Map<vector<Layer> const, Eigen::Aligned64> b() const {
+        return Eigen::Map<vector<Layer> const, Eigen::Aligned64>(storage_.get() + OFFSETS[Layer] + align(SIZES[Layer] * SIZES[Layer - 1]));
+    }
+
+    template <int Layer>
+    void forward(activation_vectors &as) const {
+        if constexpr (Layer < LAYERS) {
+            kernels::get().forward(w<Layer>().data(), b<Layer>().data(), SIZES[Layer], SIZES[Layer - 1],
+                                   std::get<Layer - 1>(as).data(), SIZES[Layer - 1],
+                                   std::get<Layer>(as).data(), SIZES[Layer], 1, activations_[Layer]);
+            forward<Layer + 1>(as);
+        }
+    }
+
+    // error is the error of the outputs of Layer
+    template <int Layer>
+    void backward(activation_vectors const &as, vector<Layer> &error) {
+        if constexpr (Layer > 1) {
+            vector<Layer - 1> previous_error;
+            update<Layer>(as, error, previous_error.data());
+            backward<Layer - 1>(as, previous_error);
+        } else {
+            update<Layer>(as, error, nullptr);
+        }
+    }
+
+    // turns error into deltas, steps Layer and writes the error of the
+    // previous layer's outputs unless previous_error is null
+    template <int Layer>
+    void update(activation_vectors const &as, vector<Layer> &error, float *previous_error) {
+        auto const &kernels = kernels::get();
+        kernels.multiply_derivative(activations_[Layer], std::get<Layer>(as).data(), SIZES[Layer],
+                                    error.data(), SIZES[Layer], SIZES[Layer], 1);
+        float *dw = gradients_.get() + OFFSETS[Layer];
+        float *db = dw + align(SIZES[Layer] * SIZES[Layer - 1]);
+        kernels.backward(w<Layer>().data(), SIZES[Layer], SIZES[Layer - 1], error.data(), SIZES[Layer],
+                         std::get<Layer - 1>(as).data(), SIZES[Layer - 1], 1, dw, db,
+                         previous_error, SIZES[Layer - 1]);
+        optimizer_settings const sgd;
+        kernels.update_weights(sgd, learning_rate_, 1, 1, w<Layer>().data(), dw, nullptr, nullptr,
+                               SIZES[Layer] * SIZES[Layer - 1]);
+        kernels.update_weights(sgd, learning_rate_, 1, 1, b<Layer>().data(), db, nullptr, nullptr, SIZES[Layer]);
+    }
+
+    template <int Layer>
+    void randomize() {
+        if constexpr (Layer < LAYERS) {
+            w<Layer>().setRandom();
+            b<Layer>().setRandom();
+            randomize<Layer + 1>();
+        }
+    }
+
+    // text coefficients hold all weights first, then all biases, row by row
+    template <int Layer>
+    void read_text(std::istream &is, bool weights) {
+        if constexpr (Layer < LAYERS) {
+            if (weights) {
+                auto matrix = w<Layer>();
+                for (int row = 0; row < matrix.rows(); row++)
+                    for (int col = 0; col < matrix.cols(); col++)
+                        is >> matrix(row, col);
+            } else {
+                auto bias = b<Layer>();
+                for (int row = 0; row < bias.rows(); row++)
+                    is >> bias(row);
+            }
+            read_text<Layer + 1>(is, weights);
+        }
+    }
+
+    template <int Layer>
+    void read_binary(std::istream &is) {
+        if constexpr (Layer < LAYERS) {
+            coefficient_file::read_block(is, w<Layer>().data(), w<Layer>().size());
+            coefficient_file::read_block(is, b<Layer>().data(), b<Layer>().size());
+            read_binary<Layer + 1>(is);
+        }
+    }
+
+    template <int Layer>
+    void save_binary(std::ostream &os) const {
+        if constexpr (Layer < LAYERS) {
+            coefficient_file::write_block(os, w<Layer>().data(), w<Layer>().size());
+            coefficient_file::write_block(os, b<Layer>().data(), b<Layer>().size());
+            save_binary<Layer + 1>(os);
+        }
+    }
+
+    float learning_rate_;
+    std::unique_ptr<float, void (*)(void*)> storage_;
+    // train's, laid out like storage_
+    std::unique_ptr<float, void (*)(void*)> gradients_;
+    // 1-based like the layers
+    std::array<activation, LAYERS> activations_;
+};
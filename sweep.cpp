@@ -0,0 +1,241 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+sweep::sweep(std::istream &spec)
+    : epochs_(10)
+    , samples_(10000)
+    , min_epochs_(2)
+    , seed_(1)
+{
+    configuration defaults;
+    std::vector<float> learning_rates{defaults.learning_rate};
+    std::vector<float> decays{defaults.decay};
+    std::vector<std::vector<size_t>> hiddens{defaults.hidden};
+    std::vector<size_t> batch_sizes{defaults.batch_size};
+    std::vector<optimizer> optimizers{defaults.optimizer};
+    std::vector<activation> activations{defaults.activation};
+    size_t random_picks = 0;
+
+    std::string line;
+    while (std::getline(spec, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream values(line);
+        std::string key;
+        if (!(values >> key))
+            continue;
+        std::vector<std::string> words;
+        for (std::string word; values >> word;)
+            words.push_back(word);
+        if (words.empty())
+            throw std::runtime_error("no values for " + key);
+
+        auto const all = [&](auto const &parse) {
+            std::vector<decltype(parse(words[0]))> parsed;
+            for (auto const &word : words)
+                parsed.push_back(parse(word));
+            return parsed;
+        };
+        if (key == "search") {
+            if (words[0] == "random" && words.size() == 2)
+                random_picks = std::stoul(words[1]);
+            else if (words[0] != "grid")
+                throw std::runtime_error("invalid search " + words[0]);
+        } else if (key == "epochs") {
+            epochs_ = std::stoul(words[0]);
+        } else if (key == "samples") {
+            samples_ = std::stoul(words[0]);
+        } else if (key == "min_epochs") {
+            min_epochs_ = std::stoul(words[0]);
+        } else if (key == "seed") {
+            seed_ = std::stoull(words[0]);
+        } else if (key == "learning_rate") {
+            learning_rates = all([](std::string const &word) { return std::stof(word); });
+        } else if (key == "decay") {
+            decays = all([](std::string const &word) { return std::stof(word); });
+        } else if (key == "hidden") {
+            hiddens = all([](std::string const &word) { return parse_layer_sizes(word); });
+        } else if (key == "batch") {
+            batch_sizes = all([](std::string const &word) { return std::max<size_t>(std::stoul(word), 1); });
+        } else if (key == "optimizer") {
+            optimizers = all([](std::string const &word) { return parse_optimizer(word); });
+        } else if (key == "activation") {
+            activations = all([](std::string const &word) {
+                auto const activation = parse_activation(word);
+                if (activation == activation::softmax)
+                    throw std::runtime_error("softmax is only supported on the output layer");
+                return activation;
+            });
+        } else {
+            throw std::runtime_error("unknown sweep key " + key);
+        }
+    }
+
+    // the grid in mixed radix, the random search draws from it
+    size_t const sizes[] = {learning_rates.size(), decays.size(), hiddens.size(), batch_sizes.size(),
+                            optimizers.size(), activations.size()};
+    size_t combinations = 1;
+    for (auto size : sizes)
+        combinations *= size;
+    auto const pick = [&](size_t combination) {
+        configuration c;
+        c.learning_rate = learning_rates[combination % sizes[0]];
+        combination /= sizes[0];
+        c.decay = decays[combination % sizes[1]];
+        combination /= sizes[1];
+        c.hidden = hiddens[combination % sizes[2]];
+        combination /= sizes[2];
+        c.batch_size = batch_sizes[combination % sizes[3]];
+        combination /= sizes[3];
+        c.optimizer = optimizers[combination % sizes[4]];
+        combination /= sizes[4];
+        c.activation = activations[combination % sizes[5]];
+        return c;
+    };
+
+    std::vector<size_t> order(combinations);
+    for (size_t combination = 0; combination < combinations; combination++)
+        order[combination] = combination;
+    if (random_picks) {
+        // distinct picks, the whole grid at most
+        std::mt19937_64 random(seed_);
+        std::shuffle(order.begin(), order.end(), random);
+        order.resize(std::min(random_picks, combinations));
+    }
+    for (auto combination : order)
+        configurations_.push_back(pick(combination));
+}
+
+std::vector<sweep::result> sweep::run(dataset const &training, dataset const &test,
+                                      std::vector<uint32_t> const &test_indices, thread_pool &pool)
+{
+    std::vector<trainee> trainees;
+    for (size_t i = 0; i < configurations_.size(); i++)
+        trainees.push_back(start(configurations_[i], training, seed_ + i));
+    std::vector<scratch> scratches(pool.size());
+
+    std::vector<trainee*> live;
+    for (auto &trainee : trainees)
+        live.push_back(&trainee);
+    for (size_t epoch = 0; epoch < epochs_ && !live.empty(); epoch++) {
+        std::atomic<size_t> next(0);
+        pool.run(pool.size(), [&](size_t thread) {
+            for (size_t i = next++; i < live.size(); i = next++)
+                train_epoch(*live[i], training, test, test_indices, scratches[thread]);
+        });
+
+        if (epoch + 1 < min_epochs_ || live.size() < 3)
+            continue;
+        std::vector<float> accuracies;
+        for (auto trainee : live)
+            accuracies.push_back(trainee->accuracy);
+        auto const middle = accuracies.begin() + accuracies.size() / 2;
+        std::nth_element(accuracies.begin(), middle, accuracies.end());
+        auto const median = *middle;
+        auto const stopped = std::remove_if(live.begin(), live.end(), [&](trainee *trainee) {
+            trainee->result.stopped = trainee->result.accuracy < median && epoch + 1 < epochs_;
+            return trainee->result.stopped;
+        });
+        live.erase(stopped, live.end());
+    }
+
+    std::vector<result> results;
+    for (auto const &trainee : trainees)
+        results.push_back(trainee.result);
+    std::stable_sort(results.begin(), results.end(), [](result const &a, result const &b) {
+        return a.accuracy > b.accuracy;
+    });
+    return results;
+}
+
+sweep::trainee sweep::start(configuration const &configuration, dataset const &training, uint64_t seed) const {
+    std::vector<size_t> sizes{digit_image::IMAGE_SIZE};
+    sizes.insert(sizes.end(), configuration.hidden.begin(), configuration.hidden.end());
+    sizes.push_back(10);
+
+    // the initial weights come from the global rand()
+    srand(seed);
+    trainee trainee;
+    trainee.nn = std::make_unique<neural_network>(configuration.learning_rate, sizes);
+    for (size_t layer = 1; layer + 1 < sizes.size(); layer++)
+        trainee.nn->set_activation(layer, configuration.activation);
+    if (configuration.activation != activation::sigmoid)
+        trainee.nn->randomize();
+    optimizer_settings settings;
+    settings.kind = configuration.optimizer;
+    trainee.nn->set_optimizer(settings);
+
+    trainee.sampler = std::make_unique<balanced_sampler>(training, false, seed);
+    trainee.result.configuration = configuration;
+    return trainee;
+}
+
+void sweep::train_epoch(trainee &trainee, dataset const &training, dataset const &test,
+                        std::vector<uint32_t> const &test_indices, scratch &scratch) const
+{
+    auto const start = std::chrono::steady_clock::now();
+    auto const &configuration = trainee.result.configuration;
+    auto const batch_size = configuration.batch_size;
+    auto &nn = *trainee.nn;
+    auto &x = scratch.x;
+    if (x.cols() < static_cast<Eigen::Index>(std::max<size_t>(batch_size, 256)))
+        x.resize(digit_image::IMAGE_SIZE, std::max<size_t>(batch_size, 256));
+    std::vector<uint32_t> indices(batch_size);
+    Eigen::VectorXi digits(batch_size);
+
+    nn.set_learning_rate(configuration.learning_rate / (1.0f + configuration.decay * trainee.result.epochs));
+    for (size_t sample = 0; sample < samples_; sample += batch_size) {
+        auto const count = std::min(batch_size, samples_ - sample);
+        for (size_t i = 0; i < count; i++) {
+            indices[i] = trainee.sampler->next(sample + i);
+            digits(i) = training.digit(indices[i]);
+        }
+        training.get_batch(indices.data(), count, x.leftCols(count));
+        nn.train_batch(digits.head(count), x.leftCols(count));
+    }
+
+    size_t correct = 0;
+    for (size_t first = 0; first < test_indices.size(); first += x.cols()) {
+        auto const count = std::min<size_t>(x.cols(), test_indices.size() - first);
+        test.get_batch(test_indices.data() + first, count, x.leftCols(count));
+        auto const ys = nn.feed_forward(x.leftCols(count), scratch.ws);
+        for (size_t i = 0; i < count; i++) {
+            Eigen::Index recognized;
+            ys.col(i).maxCoeff(&recognized);
+            correct += recognized == test.digit(test_indices[first + i]);
+        }
+    }
+    trainee.accuracy = static_cast<float>(correct) / std::max<size_t>(test_indices.size(), 1);
+    trainee.result.accuracy = std::max(trainee.result.accuracy, trainee.accuracy);
+    trainee.result.epochs++;
+
+    std::chrono::duration<float> const elapsed = std::chrono::steady_clock::now() - start;
+    trainee.result.seconds += elapsed.count();
+}
+
+void sweep::print(std::ostream &os, std::vector<result> const &results) {
+    os << "rank\taccuracy\tepochs\tseconds\tconfiguration\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        auto const &r = results[i];
+        os << i + 1 << '\t' << std::fixed << std::setprecision(4) << r.accuracy << '\t' << r.epochs
+           << (r.stopped ? " stopped" : "") << '\t' << std::setprecision(1) << r.seconds << '\t'
+           << std::defaultfloat << arguments(r.configuration) << '\n';
+    }
+}
+
+std::string sweep::arguments(configuration const &configuration) {
+    std::ostringstream os;
+    os << "--learning-rate " << configuration.learning_rate << " --decay " << configuration.decay << " --hidden ";
+    for (size_t i = 0; i < configuration.hidden.size(); i++)
+        os << (i ? "," : "") << configuration.hidden[i];
+    os << " --batch " << configuration.batch_size
+       << " --optimizer " << optimizer_name(configuration.optimizer)
+       << " --activation " << activation_name(configuration.activation);
+    return os.str();
+}
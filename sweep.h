@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "activation.h"
+#include "balanced_sampler.h"
+#include "dataset.h"
+#include "neural_network.h"
+#include "optimizer.h"
+#include "thread_pool.h"
+
+// Trains many network configurations concurrently on one shared, read-only
+// dataset and ranks them by test accuracy.
+//
+// The configurations advance in rounds of one epoch, every pool thread
+// trains one configuration's epoch at a time on its own. After every round
+// from min_epochs on, the configurations whose best accuracy is below the
+// median accuracy of the round stop, so which ones stop depends neither on
+// the number of threads nor on their timing.
+//
+// Spec file, one key and its values per line, # starts a comment:
+//   search grid           every combination, or "random N" for N distinct random picks
+//   epochs 10
+//   samples 10000         per epoch, train takes 10000
+//   min_epochs 2          before a configuration can be stopped
+//   seed 1
+//   learning_rate 0.1 0.5 1
+//   decay 0.5 0           learning_rate / (1 + decay * epoch)
+//   hidden 196,49 100     hidden layer sizes
+//   batch 1 16
+//   optimizer sgd adam
+//   activation sigmoid relu   of the hidden layers
+//
+// Every configuration samples its images like train does, see
+// balanced_sampler.
+class sweep {
+public:
+    struct configuration {
+        float learning_rate = 1.0f;
+        float decay = 0.5f;
+        std::vector<size_t> hidden{196, 49};
+        size_t batch_size = 16;
+        ::optimizer optimizer = optimizer::sgd;
+        ::activation activation = activation::sigmoid;
+    };
+
+    struct result {
+        sweep::configuration configuration;
+        size_t epochs = 0;
+        float accuracy = 0.0f;
+        float seconds = 0.0f;
+        bool stopped = false;
+    };
+
+    explicit sweep(std::istream &spec);
+
+    std::vector<configuration> const& configurations() const { return configurations_; }
+
+    // test_indices into test, ranked results, best first
+    std::vector<result> run(dataset const &training, dataset const &test, std::vector<uint32_t> const &test_indices,
+                            thread_pool &pool);
+
+    static void print(std::ostream &os, std::vector<result> const &results);
+    // the train options of a configuration
+    static std::string arguments(configuration const &configuration);
+
+private:
+    // a configuration in training
+    struct trainee {
+        std::unique_ptr<neural_network> nn;
+        std::unique_ptr<balanced_sampler> sampler;
+        sweep::result result;
+        // of the last round
+        float accuracy = 0.0f;
+    };
+
+    // buffers of one pool thread
+    struct scratch {
+        Eigen::MatrixXf x;
+        neural_network::workspace ws;
+    };
+
+    trainee start(configuration const &configuration, dataset const &training, uint64_t seed) const;
+    // trains and evaluates one epoch
+    void train_epoch(trainee &trainee, dataset const &training, dataset const &test,
+                     std::vector<uint32_t> const &test_indices, scratch &scratch) const;
+
+    std::vector<configuration> configurations_;
+    size_t epochs_;
+    size_t samples_;
+    size_t min_epochs_;
+    uint64_t seed_;
+};
@@ -0,0 +1,164 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace telemetry {
+
+static char const *const PHASE_NAMES[] = {"sampling", "augmentation", "waiting", "forward", "backward", "update", "evaluation", "checkpoint"};
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == static_cast<size_t>(phase::count));
+
+struct counter {
+    char const *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+    uint64_t previous;
+};
+
+static bool enabled_ = false;
+static std::array<std::atomic<uint64_t>, static_cast<size_t>(phase::count)> phases_;
+// forward, backward
+static std::array<std::array<std::atomic<uint64_t>, MAX_LAYERS + 1>, 2> layers_;
+// highest layer seen, the first epoch fixes the columns
+static std::atomic<int> layer_count_{0};
+static std::vector<counter> counters_;
+static std::ofstream file_;
+static bool csv_;
+static bool header_written_;
+static auto epoch_start_ = std::chrono::steady_clock::now();
+
+static void open_counters() {
+    counters_ = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0},
+        {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, 0},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0},
+    };
+    for (auto &c : counters_) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = c.type;
+        attr.config = c.config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // threads created later count too
+        attr.inherit = 1;
+        c.fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (c.fd < 0) {
+            std::cerr << "hardware counters are not available (" << std::strerror(errno) << ")\n";
+            for (auto &opened : counters_) {
+                if (opened.fd >= 0)
+                    close(opened.fd);
+            }
+            counters_.clear();
+            return;
+        }
+    }
+}
+
+void enable(std::string const &path, bool hardware_counters) {
+    file_.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+    file_.open(path, std::ofstream::out | std::ofstream::trunc);
+    csv_ = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    header_written_ = false;
+    if (hardware_counters)
+        open_counters();
+    epoch_start_ = std::chrono::steady_clock::now();
+    enabled_ = true;
+}
+
+bool enabled() {
+    return enabled_;
+}
+
+void add(phase phase, uint64_t nanoseconds) {
+    phases_[static_cast<size_t>(phase)].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void add_layer(phase phase, int layer, uint64_t nanoseconds) {
+    layer = std::min<int>(layer, MAX_LAYERS);
+    if (layer > layer_count_.load(std::memory_order_relaxed))
+        layer_count_.store(layer, std::memory_order_relaxed);
+    layers_[phase == phase::backward][layer].fetch_add(nanoseconds, std::memory_order_relaxed);
+    add(phase, nanoseconds);
+}
+
+// Whole numbers, such as epochs and counters, print as integers, anything
+// else in the shortest form that reads back to the same double.
+static void write_value(std::ostream &os, double value) {
+    if (value == std::trunc(value) && std::abs(value) < 0x1p53) {
+        os << static_cast<int64_t>(value);
+        return;
+    }
+    char buffer[32];
+    auto const result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    os.write(buffer, result.ptr - buffer);
+}
+
+void write_epoch(std::initializer_list<std::pair<char const*, double>> fields) {
+    if (!enabled_)
+        return;
+
+    auto const now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> const wall = now - epoch_start_;
+    epoch_start_ = now;
+
+    std::vector<std::pair<std::string, double>> values(fields.begin(), fields.end());
+    values.emplace_back("wall_seconds", wall.count());
+    for (size_t i = 0; i < phases_.size(); i++)
+        values.emplace_back(std::string(PHASE_NAMES[i]) + "_seconds", phases_[i].exchange(0) * 1e-9);
+    for (size_t direction = 0; direction < layers_.size(); direction++) {
+        for (int layer = 1; layer <= layer_count_.load(); layer++) {
+            values.emplace_back(std::string(direction ? "backward" : "forward") + "_layer" + std::to_string(layer) + "_seconds",
+                                layers_[direction][layer].exchange(0) * 1e-9);
+        }
+    }
+    for (auto &c : counters_) {
+        uint64_t value = 0;
+        if (read(c.fd, &value, sizeof(value)) != sizeof(value))
+            continue;
+        values.emplace_back(c.name, value - c.previous);
+        c.previous = value;
+    }
+
+    if (csv_) {
+        if (!header_written_) {
+            for (size_t i = 0; i < values.size(); i++)
+                file_ << (i ? "," : "") << values[i].first;
+            file_ << '\n';
+            header_written_ = true;
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            file_ << (i ? "," : "");
+            write_value(file_, values[i].second);
+        }
+        file_ << '\n';
+    } else {
+        file_ << '{';
+        for (size_t i = 0; i < values.size(); i++) {
+            file_ << (i ? "," : "") << '"' << values[i].first << "\":";
+            write_value(file_, values[i].second);
+        }
+        file_ << "}\n";
+    }
+    file_.flush();
+
+    for (size_t i = 0; i < phases_.size(); i++)
+        std::cout << (i ? " " : "\t") << PHASE_NAMES[i] << ' ' << values[fields.size() + 1 + i].second << 's';
+    std::cout << '\n';
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <utility>
+
+// Where the training time goes: wall-clock time per phase and per layer,
+// summed over all threads, optionally hardware counters, written once per
+// epoch to a metrics file.
+//
+// Off by default, then a scoped_timer costs one predictable branch and no
+// clock reads.
+namespace telemetry {
+    enum class phase {
+        sampling,
+        // distorting sampled images, part of sampling
+        augmentation,
+        // the trainer waiting for sampled batches
+        waiting,
+        forward,
+        backward,
+        update,
+        evaluation,
+        checkpoint,
+        count,
+    };
+
+    // layers above are summed into the last one
+    constexpr size_t const MAX_LAYERS = 8;
+
+    // Writes CSV when path ends with .csv and JSON lines otherwise. Hardware
+    // counters are skipped with a warning when perf_event_open is not
+    // permitted. Enable before starting threads, the counters only follow
+    // threads created afterwards.
+    void enable(std::string const &path, bool hardware_counters);
+    bool enabled();
+
+    void add(phase phase, uint64_t nanoseconds);
+    // phase is forward or backward, layer is 1-based
+    void add_layer(phase phase, int layer, uint64_t nanoseconds);
+
+    // Writes fields followed by the phase, layer and counter totals since the
+    // previous call, then resets them. Prints a one line summary to stdout.
+    void write_epoch(std::initializer_list<std::pair<char const*, double>> fields);
+
+    class scoped_timer {
+    public:
+        explicit scoped_timer(phase phase, int layer = 0)
+            : phase_(phase)
+            , layer_(layer)
+            , enabled_(enabled())
+        {
+            if (enabled_)
+                start_ = std::chrono::steady_clock::now();
+        }
+
+        ~scoped_timer() {
+            if (!enabled_)
+                return;
+            auto const nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count();
+            if (layer_)
+                add_layer(phase_, layer_, nanoseconds);
+            else
+                add(phase_, nanoseconds);
+        }
+
+        scoped_timer(scoped_timer const&) = delete;
+        scoped_timer& operator=(scoped_timer const&) = delete;
+
+    private:
+        phase phase_;
+        int layer_;
+        bool enabled_;
+        std::chrono::steady_clock::time_point start_;
+    };
+}
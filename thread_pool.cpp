@@ -0,0 +1,67 @@
+#include "thread_pool.h"
+
+thread_pool::thread_pool(size_t threads)
+    : invoke_(nullptr)
+    , task_(nullptr)
+    , count_(0)
+    , next_(0)
+    , busy_(0)
+    , generation_(0)
+    , stopping_(false)
+{
+    for (size_t i = 1; i < threads; i++)
+        workers_.emplace_back(&thread_pool::work, this);
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+void thread_pool::run(size_t count, void (*invoke)(void const*, size_t), void const *task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        invoke_ = invoke;
+        task_ = task;
+        count_ = count;
+        next_ = 0;
+        busy_ = workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+
+    run_tasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+void thread_pool::work() {
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != generation; });
+            if (stopping_)
+                return;
+            generation = generation_;
+        }
+
+        run_tasks();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0)
+            done_.notify_one();
+    }
+}
+
+void thread_pool::run_tasks() {
+    for (size_t i = next_++; i < count_; i = next_++)
+        invoke_(task_, i);
+}
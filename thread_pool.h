@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+    explicit thread_pool(size_t threads);
+    ~thread_pool();
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+
+    // calling thread included
+    size_t size() const { return workers_.size() + 1; }
+
+    // Runs task(0) ... task(count - 1) on the pool and the calling thread,
+    // returns once all of them have finished. Doesn't allocate.
+    template <typename Task>
+    void run(size_t count, Task const &task) {
+        run(count, [](void const *task, size_t i) { (*static_cast<Task const*>(task))(i); }, &task);
+    }
+
+private:
+    void run(size_t count, void (*invoke)(void const*, size_t), void const *task);
+    void work();
+    void run_tasks();
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    void (*invoke_)(void const*, size_t);
+    void const *task_;
+    size_t count_;
+    std::atomic<size_t> next_;
+    size_t busy_;
+    uint64_t generation_;
+    bool stopping_;
+};
@@ -0,0 +1,74 @@
+#include "trainer.h"
+
+#include <algorithm>
+
+trainer::trainer(neural_network &nn, thread_pool &pool, mode mode, size_t batch_size)
+    : nn_(nn)
+    , pool_(pool)
+    , mode_(mode)
+    , batch_size_(std::max<size_t>(batch_size, 1))
+    , workspaces_(pool.size())
+{}
+
+void trainer::train(Eigen::Ref<Eigen::VectorXi const> const &digits, Eigen::Ref<Eigen::MatrixXf const> const &x) {
+    assert(digits.size() == x.cols());
+    size_t const samples = x.cols();
+
+    switch (mode_) {
+        case mode::synchronous:
+            for (size_t sample = 0; sample < samples; sample += batch_size_) {
+                auto const size = std::min(batch_size_, samples - sample);
+                train_synchronous(digits.segment(sample, size), x.middleCols(sample, size));
+            }
+            break;
+        case mode::hogwild:
+            pool_.run(pool_.size(), [&](size_t thread) {
+                auto const begin = samples * thread / pool_.size();
+                auto const end = samples * (thread + 1) / pool_.size();
+                train_hogwild(digits.segment(begin, end - begin), x.middleCols(begin, end - begin), thread);
+            });
+            break;
+        default:
+            throw std::out_of_range("invalid mode_");
+    }
+}
+
+void trainer::train_synchronous(Eigen::Ref<Eigen::VectorXi const> const &digits,
+                                Eigen::Ref<Eigen::MatrixXf const> const &x)
+{
+    size_t const samples = x.cols();
+    if (pool_.size() == 1 || samples == 1) {
+        nn_.compute_gradient(digits, x, workspaces_[0]);
+        nn_.apply_gradient(workspaces_[0].g, samples, nn_.begin_step());
+        return;
+    }
+
+    // the first `slices` gradients are non-empty
+    auto const slices = std::min(pool_.size(), samples);
+    pool_.run(slices, [&](size_t slice) {
+        auto const begin = samples * slice / slices;
+        auto const end = samples * (slice + 1) / slices;
+        nn_.compute_gradient(digits.segment(begin, end - begin), x.middleCols(begin, end - begin), workspaces_[slice]);
+    });
+
+    // reduce into the first gradient and apply it, every thread taking a share of the columns
+    auto const step = nn_.begin_step();
+    pool_.run(pool_.size(), [&](size_t part) {
+        for (size_t slice = 1; slice < slices; slice++)
+            workspaces_[0].g.add(workspaces_[slice].g, part, pool_.size());
+        nn_.apply_gradient(workspaces_[0].g, samples, step, part, pool_.size());
+    });
+}
+
+void trainer::train_hogwild(Eigen::Ref<Eigen::VectorXi const> const &digits,
+                            Eigen::Ref<Eigen::MatrixXf const> const &x,
+                            size_t thread)
+{
+    auto &ws = workspaces_[thread];
+    size_t const samples = x.cols();
+    for (size_t sample = 0; sample < samples; sample += batch_size_) {
+        auto const size = std::min(batch_size_, samples - sample);
+        nn_.compute_gradient(digits.segment(sample, size), x.middleCols(sample, size), ws);
+        nn_.apply_gradient(ws.g, size, nn_.begin_step());
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "neural_network.h"
+#include "thread_pool.h"
+
+// Splits training batches across the threads of a pool.
+class trainer {
+public:
+    enum class mode {
+        // every batch is split across the threads, their gradients are
+        // reduced and applied as one averaged update
+        synchronous,
+        // every thread trains on its own part of the samples and updates
+        // the shared weights without any locking
+        hogwild,
+    };
+
+    trainer(neural_network &nn, thread_pool &pool, mode mode, size_t batch_size);
+
+    // x holds one sample per column, trained in batches of batch_size
+    void train(Eigen::Ref<Eigen::VectorXi const> const &digits, Eigen::Ref<Eigen::MatrixXf const> const &x);
+
+private:
+    void train_synchronous(Eigen::Ref<Eigen::VectorXi const> const &digits,
+                           Eigen::Ref<Eigen::MatrixXf const> const &x);
+    void train_hogwild(Eigen::Ref<Eigen::VectorXi const> const &digits,
+                       Eigen::Ref<Eigen::MatrixXf const> const &x,
+                       size_t thread);
+
+    neural_network &nn_;
+    thread_pool &pool_;
+    mode mode_;
+    size_t batch_size_;
+    // one per thread
+    std::vector<neural_network::workspace> workspaces_;
+};